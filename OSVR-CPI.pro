@@ -11,23 +11,40 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = OSVR_CPI
 TEMPLATE = app
 
+# The profile store and the plugin code it shares use C++11
+CONFIG += c++11
+
 
 SOURCES += main.cpp\
         mainwindow.cpp \
     osvruser.cpp \
+    osvruserderived.cpp \
+    userprofilestore.cpp \
+    profiledatabase.cpp \
     lib_json/json_reader.cpp \
     lib_json/json_value.cpp \
-    lib_json/json_writer.cpp
+    lib_json/json_writer.cpp \
+    lib_json/json_pointer.cpp \
+    lib_json/json_patch.cpp \
+    lib_json/json_snapshot.cpp \
+    lib_json/json_parallel.cpp
 
 HEADERS  += mainwindow.h \
     osvruser.h \
+    osvruserderived.h \
+    userprofilestore.h \
+    profiledatabase.h \
     json/assertions.h \
     json/autolink.h \
     json/config.h \
     json/features.h \
     json/forwards.h \
     json/json.h \
+    json/patch.h \
+    json/parallel.h \
+    json/pointer.h \
     json/reader.h \
+    json/snapshot.h \
     json/value.h \
     json/version.h \
     json/writer.h \
@@ -0,0 +1,358 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#include "bench.h"
+#include <json/version.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace JsonBench {
+
+volatile size_t sink;
+
+static const size_t sampleCount = 5;
+
+double now() {
+#if defined(_WIN32)
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return double(count.QuadPart) * 1e9 / double(frequency.QuadPart);
+#else
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return double(time.tv_sec) * 1e9 + double(time.tv_nsec);
+#endif
+}
+
+// Cache misses
+// //////////////////////////////////////////////////////////////////
+
+/// A disabled counter of this thread's cache misses, or -1 where the
+/// platform or its settings (perf_event_paranoid, containers) allow none.
+static int openCacheMissCounter() {
+#if defined(__linux__)
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+  return -1;
+#endif
+}
+
+static void enableCounter(int counter, bool enable) {
+#if defined(__linux__)
+  if (counter >= 0)
+    ioctl(counter, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+#else
+  (void)counter;
+  (void)enable;
+#endif
+}
+
+static unsigned long long readCounter(int counter) {
+  unsigned long long count = 0;
+#if defined(__linux__)
+  if (counter >= 0 && read(counter, &count, sizeof(count)) != sizeof(count))
+    count = 0;
+#else
+  (void)counter;
+#endif
+  return count;
+}
+
+// class State
+// //////////////////////////////////////////////////////////////////
+
+State::State(size_t size, double minTimeNs)
+    : size_(size), items_(size), minTimeNs_(minTimeNs), phase_(counting),
+      started_(false), sampleStart_(0), pausedAt_(0), pausedNs_(0),
+      samplePasses_(0), passes_(0), extraLocks_(0), extraLocksAt_(0),
+      cacheMissCounter_(openCacheMissCounter()), cacheMisses_(0) {}
+
+State::~State() {
+#if defined(__linux__)
+  if (cacheMissCounter_ >= 0)
+    close(cacheMissCounter_);
+#endif
+}
+
+bool State::keepRunning() {
+  double time = now();
+  switch (phase_) {
+  case counting:
+    if (!started_) {
+      started_ = true;
+      Json::MemoryHooks::install(&counter_);
+      extraLocksAt_ = Json::Value::extraStatistics().locks;
+      return true;
+    }
+    Json::MemoryHooks::install(0);
+    memory_ = counter_.statistics();
+    extraLocks_ += Json::Value::extraStatistics().locks - extraLocksAt_;
+    phase_ = timing;
+    enableCounter(cacheMissCounter_, true);
+    sampleStart_ = now();
+    return true;
+  case timing: {
+    ++samplePasses_;
+    double elapsed = time - sampleStart_ - pausedNs_;
+    if (elapsed < minTimeNs_ / sampleCount)
+      return true;
+    samples_.push_back(elapsed / double(samplePasses_));
+    passes_ += samplePasses_;
+    if (samples_.size() == sampleCount) {
+      enableCounter(cacheMissCounter_, false);
+      cacheMisses_ = readCounter(cacheMissCounter_);
+      phase_ = done;
+      return false;
+    }
+    samplePasses_ = 0;
+    pausedNs_ = 0;
+    sampleStart_ = now();
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void State::pauseTiming() {
+  if (phase_ == counting) {
+    Json::MemoryHooks::install(0);
+    extraLocks_ += Json::Value::extraStatistics().locks - extraLocksAt_;
+  } else {
+    enableCounter(cacheMissCounter_, false);
+    pausedAt_ = now();
+  }
+}
+
+void State::resumeTiming() {
+  if (phase_ == counting) {
+    Json::MemoryHooks::install(&counter_);
+    extraLocksAt_ = Json::Value::extraStatistics().locks;
+  } else {
+    pausedNs_ += now() - pausedAt_;
+    enableCounter(cacheMissCounter_, true);
+  }
+}
+
+Json::Value State::result() const {
+  Json::Value result(Json::objectValue);
+  std::vector<double> samples(samples_);
+  std::sort(samples.begin(), samples.end());
+  double nsPerPass = samples.empty() ? 0.0 : samples[samples.size() / 2];
+  double fastest = samples.empty() ? 0.0 : samples[0];
+  double items = items_ ? double(items_) : 1.0;
+  result["passes"] = Json::UInt64(passes_);
+  result["itemsPerPass"] = Json::UInt64(items_);
+  result["nsPerPass"] = Json::UInt64(nsPerPass + 0.5);
+  result["nsPerItem"] = nsPerPass / items;
+  result["minNsPerItem"] = fastest / items;
+  result["allocations"] = Json::UInt64(memory_.allocations);
+  result["releases"] = Json::UInt64(memory_.releases);
+  result["peakBytes"] = Json::UInt64(memory_.peakBytes);
+  result["extraLocks"] = Json::UInt64(extraLocks_);
+  if (cacheMissCounter_ >= 0 && passes_)
+    result["cacheMissesPerItem"] =
+        double(cacheMisses_) / double(passes_) / items;
+  else
+    result["cacheMissesPerItem"] = Json::Value();
+  return result;
+}
+
+// Options
+// //////////////////////////////////////////////////////////////////
+
+Options::Options() : minTimeNs(200e6) {}
+
+static void splitList(const std::string& text,
+                      std::vector<std::string>& items) {
+  items.clear();
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    size_t end = text.find(',', begin);
+    if (end == std::string::npos)
+      end = text.size();
+    if (end > begin)
+      items.push_back(text.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
+
+static void splitNumbers(const std::string& text,
+                         std::vector<size_t>& numbers) {
+  std::vector<std::string> items;
+  splitList(text, items);
+  numbers.clear();
+  for (size_t item = 0; item < items.size(); ++item)
+    numbers.push_back(strtoul(items[item].c_str(), 0, 10));
+}
+
+bool parseOptions(int argc, char* argv[], Options& options, const char* usage) {
+  for (int index = 1; index < argc; ++index) {
+    std::string name = argv[index];
+    if (name == "--help" || index + 1 == argc) {
+      fprintf(stderr, "%s", usage);
+      return false;
+    }
+    std::string value = argv[++index];
+    if (name == "--filter") {
+      options.filter = value;
+    } else if (name == "--min-time") {
+      options.minTimeNs = atof(value.c_str()) * 1e6;
+    } else if (name == "--baseline") {
+      options.baseline = value;
+    } else if (name == "--output") {
+      options.output = value;
+    } else if (name == "--data") {
+      options.dataDir = value;
+    } else if (name == "--write-corpus") {
+      options.corpusDir = value;
+    } else if (name == "--shapes") {
+      splitList(value, options.shapes);
+    } else if (name == "--sizes") {
+      splitNumbers(value, options.sizes);
+    } else if (name == "--threads") {
+      splitNumbers(value, options.threads);
+    } else if (name == "--check-schema") {
+      options.schema = value;
+    } else {
+      fprintf(stderr, "Unknown option %s\n\n%s", name.c_str(), usage);
+      return false;
+    }
+  }
+  return true;
+}
+
+// class Report
+// //////////////////////////////////////////////////////////////////
+
+/// What identifies a result across runs.
+static std::string resultKey(const Json::Value& result) {
+  static const char* const members[] = { "name", "shape", "size", "document",
+                                         "threads" };
+  Json::Value key(Json::objectValue);
+  for (size_t index = 0; index < sizeof(members) / sizeof(members[0]);
+       ++index) {
+    if (const Json::Value* member = result.find(Json::Key(members[index])))
+      key[members[index]] = *member;
+  }
+  Json::FastWriter writer;
+  writer.omitEndingLineFeed();
+  return writer.write(key);
+}
+
+Report::Report(const char* suite, const Options& options)
+    : options_(options), report_(Json::objectValue) {
+  report_["suite"] = suite;
+  report_["jsoncppVersion"] = JSONCPP_VERSION_STRING;
+  Json::Value& settings = report_["settings"];
+  settings["filter"] = options.filter;
+  settings["minTimeMs"] = options.minTimeNs / 1e6;
+  report_["results"] = Json::Value(Json::arrayValue);
+}
+
+void Report::note(const char* name, const Json::Value& value) {
+  report_[name] = value;
+}
+
+void Report::add(const Json::Value& result) {
+  report_["results"].append(result);
+  std::string what = result.isMember("shape") ? result["shape"].asString()
+                                              : result["document"].asString();
+  if (result.isMember("size"))
+    what += (what.empty() ? "" : "/") + result["size"].asString();
+  if (result.isMember("threads"))
+    what += "/" + result["threads"].asString() + "t";
+  std::string allocations = result["allocations"].isNull()
+                                ? "n/a"
+                                : result["allocations"].asString();
+  char misses[32] = "n/a";
+  if (result["cacheMissesPerItem"].isNumeric())
+    sprintf(misses, "%.2f", result["cacheMissesPerItem"].asDouble());
+  fprintf(stderr,
+          "%-28s %-24s %12.2f ns/item %10s allocs/pass %8s misses/item\n",
+          result["name"].asCString(),
+          what.c_str(),
+          result["nsPerItem"].asDouble(),
+          allocations.c_str(),
+          misses);
+}
+
+int Report::write() {
+  Json::Value& results = report_["results"];
+  if (!options_.baseline.empty()) {
+    std::ifstream file(options_.baseline.c_str(), std::ifstream::binary);
+    Json::Value baseline;
+    Json::Reader reader;
+    if (!file || !reader.parse(file, baseline)) {
+      fprintf(stderr,
+              "Cannot read the baseline %s\n%s",
+              options_.baseline.c_str(),
+              reader.getFormattedErrorMessages().c_str());
+      return 1;
+    }
+    report_["settings"]["baseline"] = options_.baseline;
+    std::map<std::string, const Json::Value*> before;
+    const Json::Value& baseResults = baseline["results"];
+    for (Json::ArrayIndex index = 0; index < baseResults.size(); ++index)
+      before[resultKey(baseResults[index])] = &baseResults[index];
+    for (Json::ArrayIndex index = 0; index < results.size(); ++index) {
+      Json::Value& result = results[index];
+      std::map<std::string, const Json::Value*>::const_iterator match =
+          before.find(resultKey(result));
+      if (match == before.end())
+        continue;
+      double base = (*match->second)["nsPerItem"].asDouble();
+      double ratio = base > 0 ? result["nsPerItem"].asDouble() / base : 0;
+      result["baselineNsPerItem"] = base;
+      result["ratio"] = ratio;
+      if (ratio > 1.1 || (ratio > 0 && ratio < 0.9))
+        fprintf(stderr,
+                "%s %.2fx %s\n",
+                ratio > 1 ? "SLOWER" : "faster",
+                ratio,
+                match->first.c_str());
+    }
+  }
+
+  std::string text = Json::StyledWriter().write(report_);
+  if (options_.output.empty()) {
+    std::cout << text;
+    return 0;
+  }
+  std::ofstream file(options_.output.c_str(), std::ofstream::binary);
+  file << text;
+  if (!file) {
+    fprintf(stderr, "Cannot write %s\n", options_.output.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace JsonBench
@@ -0,0 +1,157 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSONBENCH_BENCH_H_INCLUDED
+#define JSONBENCH_BENCH_H_INCLUDED
+
+#include <json/json.h>
+#include <string>
+#include <vector>
+
+namespace JsonBench {
+
+/// Monotonic time in nanoseconds.
+double now();
+
+/// Benchmarks add their results here so the compiler cannot drop the work.
+extern volatile size_t sink;
+
+/// Deterministic numbers, so every build benchmarks the same documents.
+class Random {
+public:
+  Random() : state_(2016) {}
+  unsigned int next() {
+    state_ = state_ * 1103515245u + 12345u;
+    return (state_ >> 16) & 0x7fff;
+  }
+  double real(double low, double high) {
+    return low + (high - low) * double(next()) / 32767.0;
+  }
+
+private:
+  unsigned int state_;
+};
+
+/** \brief Drives the measuring loop of one benchmark case.
+ *
+ * \code
+ * while (state.keepRunning()) {
+ *   ... one pass over state.size() items ...
+ * }
+ * \endcode
+ * The first pass runs with a Json::MemoryCounter installed and is not timed.
+ * The following passes are timed in five samples that together take the
+ * minimum time; the median sample is reported, so that one disturbed sample
+ * does not skew the result. Work between pauseTiming() and resumeTiming() is
+ * neither timed nor counted. Where the platform lets a process count its
+ * own cache misses (Linux perf events), the timed passes count them too.
+ */
+class State {
+public:
+  State(size_t size, double minTimeNs);
+  ~State();
+
+  bool keepRunning();
+  void pauseTiming();
+  void resumeTiming();
+
+  size_t size() const { return size_; }
+  /// Items one pass handles, for the per-item figures; size() by default.
+  void setItemsPerPass(size_t items) { items_ = items; }
+
+  /// Timings, allocation counts, side table locks and cache misses (null
+  /// where they cannot be counted), as a JSON object.
+  Json::Value result() const;
+
+private:
+  State(const State&);
+  State& operator=(const State&);
+
+  enum Phase {
+    counting,
+    timing,
+    done
+  };
+
+  size_t size_;
+  size_t items_;
+  double minTimeNs_;
+  Phase phase_;
+  bool started_;
+  double sampleStart_;
+  double pausedAt_;
+  double pausedNs_;
+  size_t samplePasses_;
+  size_t passes_;
+  std::vector<double> samples_; // ns per pass
+
+  Json::MemoryCounter counter_;
+  Json::MemoryStatistics memory_;
+  /// Locks of the comment and offset side table in the counted pass.
+  size_t extraLocks_;
+  size_t extraLocksAt_;
+  /// perf event file descriptor, or -1
+  int cacheMissCounter_;
+  unsigned long long cacheMisses_;
+};
+
+/// Command line settings shared by the benchmark programs.
+struct Options {
+  Options();
+
+  /// Run only the cases whose name contains this.
+  std::string filter;
+  /// Minimum timed duration of each case.
+  double minTimeNs;
+  /// Results of an earlier run to compare with, or empty.
+  std::string baseline;
+  /// Where to write the report; empty for standard output.
+  std::string output;
+  /// Values of --sizes and --shapes, for bench_value.
+  std::vector<size_t> sizes;
+  std::vector<std::string> shapes;
+  /// Values of --data and --write-corpus, for bench_readwrite.
+  std::string dataDir;
+  std::string corpusDir;
+  /// Value of --threads, for bench_parallel.
+  std::vector<size_t> threads;
+  /// Value of --check-schema, for bench_profiles.
+  std::string schema;
+};
+
+/** Parse the command line into \a options. Print \a usage and return false
+ * on --help or a bad argument.
+ */
+bool parseOptions(int argc, char* argv[], Options& options, const char* usage);
+
+/** \brief Collects the results of one run and writes them as JSON.
+ *
+ * The report is an object with the suite name, the library version, the
+ * settings and a "results" array. With a baseline, each result that matches
+ * one in it (same "name", "shape", "size", "document" and "threads") also
+ * gets the baseline's nsPerItem and the ratio of the two, and a summary line
+ * goes to standard error for each ratio past 10%.
+ */
+class Report {
+public:
+  Report(const char* suite, const Options& options);
+
+  /// Add \a result, as made by State::result() plus identifying members.
+  void add(const Json::Value& result);
+  /// Record a fact about the build, such as a type's size, at the top of
+  /// the report.
+  void note(const char* name, const Json::Value& value);
+  /// Compare with the baseline, if any, and write the report. Return the
+  /// process exit code.
+  int write();
+
+private:
+  const Options& options_;
+  Json::Value report_;
+};
+
+} // namespace JsonBench
+
+#endif // JSONBENCH_BENCH_H_INCLUDED
@@ -0,0 +1,376 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+/* Scaling of the parallel reader and writers with the number of threads,
+ * over documents made of one large array: a recorded tracker session and an
+ * export of user profiles. Also the scaling of parseMany() over a fleet of
+ * small per-user settings files. The sequential Reader and writers are
+ * measured alongside as the baseline.
+ *
+ * The readers also run without source offsets. Offsets are kept in a side
+ * table shared by all threads; if its lock limited scaling, the cases with
+ * offsets would fall behind the noOffsets ones as threads are added. The
+ * report's extraLocks gives how often one pass locked that table.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+
+using JsonBench::Random;
+using JsonBench::State;
+using JsonBench::sink;
+
+static const char usage[] =
+    "Usage: bench_parallel [--filter TEXT] [--threads LIST] [--min-time MS]\n"
+    "                      [--baseline REPORT] [--output FILE]\n"
+    "\n"
+    "  --filter    run only the cases whose name or document contains TEXT\n"
+    "  --threads   comma-separated thread counts (default 1,2,4 and the\n"
+    "              number of hardware threads)\n"
+    "  --min-time  timed milliseconds per case (default 200)\n"
+    "  --baseline  add the ratios to an earlier report\n"
+    "  --output    write the report there instead of standard output\n";
+
+/// One large document, or a set of small files.
+struct Workload {
+  std::string name;
+  /// The document, or every file one after the other.
+  std::string text;
+  /// The files, for the parseMany() cases; empty for one document.
+  std::vector<std::string> files;
+};
+
+// Documents
+// //////////////////////////////////////////////////////////////////
+
+/// A recorded tracker session: one small record per sample.
+static void makeSession(Json::Value& root, Random& random) {
+  root = Json::Value(Json::arrayValue);
+  for (unsigned int index = 0; index < 60000; ++index) {
+    Json::Value& sample = root.append(Json::Value(Json::objectValue));
+    sample["t"] = Json::UInt64(1470000000000ull + index * 2);
+    sample["sensor"] = index % 3;
+    Json::Value& position = sample["position"];
+    for (int axis = 0; axis < 3; ++axis)
+      position.append(random.real(-2, 2));
+    Json::Value& orientation = sample["orientation"];
+    for (int axis = 0; axis < 4; ++axis)
+      orientation.append(random.real(-1, 1));
+  }
+}
+
+/// Every profile of a site, exported as one array.
+static void makeProfileExport(Json::Value& root, Random& random) {
+  static const char* const genders[] = { "Male", "Female" };
+  root = Json::Value(Json::arrayValue);
+  for (unsigned int index = 0; index < 20000; ++index) {
+    Json::Value& profile = root.append(Json::Value(Json::objectValue));
+    char name[32];
+    sprintf(name, "user%05u", index);
+    profile["name"] = name;
+    profile["gender"] = genders[random.next() % 2];
+    profile["standingEyeHeight"] = random.real(1.4, 2.0);
+    profile["seatedEyeHeight"] = random.real(1.0, 1.4);
+    const char* const sides[] = { "left", "right" };
+    for (int side = 0; side < 2; ++side) {
+      Json::Value& eye = profile["eyes"][sides[side]];
+      eye["pupilDistance"] = random.real(28, 36);
+      eye["spherical"] = random.real(-4, 4);
+      eye["dominant"] = side == 0;
+    }
+    profile["anthropometric"]["standingHeight"] = random.real(1.5, 2.1);
+  }
+}
+
+/// One user's osvr_user_settings.json.
+static void makeUserSettings(Json::Value& root, Random& random) {
+  static const char* const genders[] = { "male", "female" };
+  Json::Value& settings = root["personalSettings"];
+  settings["gender"] = genders[random.next() % 2];
+  const char* const sides[] = { "left", "right" };
+  for (int side = 0; side < 2; ++side) {
+    Json::Value& eye = settings["eyes"][sides[side]];
+    if (side == 0)
+      eye["dominant"] = random.next() % 2 == 0;
+    eye["pupilDistance"] = random.real(28, 36);
+    Json::Value& distance = eye["correction"]["distance"];
+    distance["spherical"] = random.real(-6, 6);
+    distance["cylindrical"] = random.real(-2, 0);
+    distance["axis"] = random.next() % 180;
+    eye["correction"]["addNear"]["spherical"] = random.real(0, 3);
+  }
+  Json::Value& body = settings["anthropometric"];
+  body["standingEyeHeight"] = random.real(1.4, 2.0);
+  body["seatedEyeHeight"] = random.real(1.0, 1.4);
+  body["eyeToNeck"] = random.real(15, 25);
+}
+
+static void makeDocuments(std::vector<Workload>& documents) {
+  typedef void (*Generator)(Json::Value& root, Random& random);
+  static const struct {
+    const char* name;
+    Generator generate;
+  } generated[] = {
+    { "session", makeSession },
+    { "profile-export", makeProfileExport },
+  };
+  for (size_t index = 0; index < sizeof(generated) / sizeof(generated[0]);
+       ++index) {
+    Random random;
+    Json::Value root;
+    generated[index].generate(root, random);
+    Workload document;
+    document.name = generated[index].name;
+    document.text = Json::StyledWriter().write(root);
+    documents.push_back(document);
+  }
+
+  Random random;
+  Workload fleet;
+  fleet.name = "settings-fleet";
+  for (int user = 0; user < 4000; ++user) {
+    Json::Value root;
+    makeUserSettings(root, random);
+    fleet.files.push_back(Json::StyledWriter().write(root));
+    fleet.text += fleet.files.back();
+  }
+  documents.push_back(fleet);
+}
+
+// Cases
+// //////////////////////////////////////////////////////////////////
+
+static void benchReader(State& state,
+                        const Workload& document,
+                        unsigned int) {
+  const char* begin = document.text.data();
+  const char* end = begin + document.text.size();
+  Json::Reader reader;
+  while (state.keepRunning()) {
+    Json::Value root;
+    sink += reader.parse(begin, end, root, false);
+    state.pauseTiming();
+    Json::Value().swap(root);
+    state.resumeTiming();
+  }
+}
+
+static void benchParallelReader(State& state,
+                                const Workload& document,
+                                unsigned int threads,
+                                bool collectOffsets) {
+  const char* begin = document.text.data();
+  const char* end = begin + document.text.size();
+  Json::WorkerPool pool(threads);
+  Json::Features features;
+  features.collectOffsets_ = collectOffsets;
+  Json::ParallelReader reader(pool, features);
+  while (state.keepRunning()) {
+    Json::Value root;
+    sink += reader.parse(begin, end, root);
+    state.pauseTiming();
+    Json::Value().swap(root);
+    state.resumeTiming();
+  }
+}
+
+static void benchParallelReaderOffsets(State& state,
+                                       const Workload& document,
+                                       unsigned int threads) {
+  benchParallelReader(state, document, threads, true);
+}
+
+/// Without source offsets no Value takes an entry of the side table, so the
+/// difference from the case above is what sharing that table costs.
+static void benchParallelReaderNoOffsets(State& state,
+                                         const Workload& document,
+                                         unsigned int threads) {
+  benchParallelReader(state, document, threads, false);
+}
+
+/// Parse the document once, for the writer cases.
+static void parse(const Workload& document, Json::Value& root) {
+  Json::Reader reader;
+  const char* begin = document.text.data();
+  if (!reader.parse(begin, begin + document.text.size(), root))
+    fprintf(stderr,
+            "%s does not parse:\n%s",
+            document.name.c_str(),
+            reader.getFormattedErrorMessages().c_str());
+}
+
+/// Write with \a writer, on a pool of \a threads unless that is 0.
+template <typename Writer>
+static void benchWriter(State& state,
+                        const Workload& document,
+                        unsigned int threads) {
+  Json::Value root;
+  parse(document, root);
+  Json::WorkerPool pool(threads ? threads : 1);
+  Writer writer;
+  if (threads)
+    writer.useWorkerPool(&pool);
+  while (state.keepRunning())
+    sink += writer.write(root).size();
+}
+
+static void benchFastWriter(State& state,
+                            const Workload& document,
+                            unsigned int) {
+  benchWriter<Json::FastWriter>(state, document, 0);
+}
+
+static void benchStyledWriter(State& state,
+                              const Workload& document,
+                              unsigned int) {
+  benchWriter<Json::StyledWriter>(state, document, 0);
+}
+
+/// Read every file in turn with one Reader, as tools do today.
+static void benchReaderLoop(State& state,
+                            const Workload& document,
+                            unsigned int) {
+  state.setItemsPerPass(document.files.size());
+  Json::Reader reader;
+  std::vector<Json::Value> roots(document.files.size());
+  while (state.keepRunning()) {
+    for (size_t file = 0; file < document.files.size(); ++file)
+      sink += reader.parse(document.files[file], roots[file], false);
+    state.pauseTiming();
+    std::vector<Json::Value>(document.files.size()).swap(roots);
+    state.resumeTiming();
+  }
+}
+
+static void benchParseMany(State& state,
+                           const Workload& document,
+                           unsigned int threads,
+                           bool useArena,
+                           bool collectOffsets) {
+  state.setItemsPerPass(document.files.size());
+  std::vector<Json::DocumentText> texts(document.files.size());
+  for (size_t file = 0; file < texts.size(); ++file) {
+    texts[file].begin_ = document.files[file].data();
+    texts[file].end_ = texts[file].begin_ + document.files[file].size();
+  }
+  Json::WorkerPool pool(threads);
+  Json::CharReaderBuilder builder;
+  builder.collectComments_ = false;
+  builder.useArena_ = useArena;
+  builder.features_.collectOffsets_ = collectOffsets;
+  std::vector<Json::Document> parsed(texts.size());
+  std::vector<std::string> errors(texts.size());
+  while (state.keepRunning()) {
+    sink += Json::parseMany(
+        pool, builder, &texts[0], texts.size(), &parsed[0], &errors[0]);
+    state.pauseTiming();
+    for (size_t file = 0; file < parsed.size(); ++file)
+      parsed[file].clear();
+    state.resumeTiming();
+  }
+}
+
+static void benchParseManyHeap(State& state,
+                               const Workload& document,
+                               unsigned int threads) {
+  benchParseMany(state, document, threads, false, true);
+}
+
+static void benchParseManyNoOffsets(State& state,
+                                    const Workload& document,
+                                    unsigned int threads) {
+  benchParseMany(state, document, threads, false, false);
+}
+
+static void benchParseManyArena(State& state,
+                                const Workload& document,
+                                unsigned int threads) {
+  benchParseMany(state, document, threads, true, true);
+}
+
+typedef void (*BenchFunction)(State& state,
+                              const Workload& document,
+                              unsigned int threads);
+
+static const struct {
+  const char* name;
+  /// Run once per thread count; the others run once.
+  bool threaded;
+  /// Run on sets of files; the others on single documents.
+  bool files;
+  BenchFunction run;
+} benchmarks[] = {
+  { "read.Reader", false, false, benchReader },
+  { "read.ParallelReader", true, false, benchParallelReaderOffsets },
+  { "read.ParallelReader.noOffsets", true, false,
+    benchParallelReaderNoOffsets },
+  { "write.FastWriter", false, false, benchFastWriter },
+  { "write.FastWriter.pool", true, false, benchWriter<Json::FastWriter> },
+  { "write.StyledWriter", false, false, benchStyledWriter },
+  { "write.StyledWriter.pool", true, false, benchWriter<Json::StyledWriter> },
+  { "read.Reader.loop", false, true, benchReaderLoop },
+  { "read.parseMany", true, true, benchParseManyHeap },
+  { "read.parseMany.noOffsets", true, true, benchParseManyNoOffsets },
+  { "read.parseMany.arena", true, true, benchParseManyArena },
+};
+
+int main(int argc, char* argv[]) {
+  JsonBench::Options options;
+  if (!JsonBench::parseOptions(argc, argv, options, usage))
+    return 2;
+  if (options.threads.empty()) {
+    Json::WorkerPool hardware;
+    for (size_t threads = 1; threads < hardware.threads() && threads <= 4;
+         threads *= 2)
+      options.threads.push_back(threads);
+    options.threads.push_back(hardware.threads());
+  }
+
+  std::vector<Workload> documents;
+  makeDocuments(documents);
+
+  JsonBench::Report report("bench_parallel", options);
+  for (size_t bench = 0; bench < sizeof(benchmarks) / sizeof(benchmarks[0]);
+       ++bench) {
+    for (size_t index = 0; index < documents.size(); ++index) {
+      const Workload& document = documents[index];
+      if (benchmarks[bench].files == document.files.empty())
+        continue;
+      if (std::string(benchmarks[bench].name).find(options.filter) ==
+              std::string::npos &&
+          document.name.find(options.filter) == std::string::npos)
+        continue;
+      std::vector<size_t> threadCounts(1, 1);
+      if (benchmarks[bench].threaded)
+        threadCounts = options.threads;
+      double single = 0;
+      for (size_t count = 0; count < threadCounts.size(); ++count) {
+        State state(1, options.minTimeNs);
+        benchmarks[bench].run(
+            state, document, static_cast<unsigned int>(threadCounts[count]));
+        Json::Value result = state.result();
+        double nsPerPass = result["nsPerPass"].asDouble();
+        result["name"] = benchmarks[bench].name;
+        result["document"] = document.name;
+        result["bytes"] = Json::UInt64(document.text.size());
+        if (benchmarks[bench].threaded)
+          result["threads"] = Json::UInt64(threadCounts[count]);
+        if (nsPerPass > 0) {
+          result["mbPerSecond"] =
+              double(document.text.size()) * 1e3 / nsPerPass;
+          if (!document.files.empty())
+            result["documentsPerSecond"] =
+                double(document.files.size()) * 1e9 / nsPerPass;
+          // Against the first thread count, normally 1.
+          if (count == 0)
+            single = nsPerPass;
+          result["speedup"] = single / nsPerPass;
+        }
+        report.add(result);
+      }
+    }
+  }
+  return report.write();
+}
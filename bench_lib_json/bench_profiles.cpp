@@ -0,0 +1,201 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+/* Cost of finding one user among many: in the memory-mapped profile
+ * database, in a UserProfileStore already in memory, and by reading that
+ * user's own osvr_user_settings.json, which is what a directory of per-user
+ * files costs for every profile scanned at startup.
+ */
+
+#include "bench.h"
+#include "../profiledatabase.h"
+#include "../userprofilestore.h"
+#include <fstream>
+#include <stdio.h>
+
+using JsonBench::Random;
+using JsonBench::State;
+using JsonBench::sink;
+
+static const char usage[] =
+    "Usage: bench_profiles [--filter TEXT] [--sizes LIST] [--min-time MS]\n"
+    "                      [--baseline REPORT] [--output FILE]\n"
+    "       bench_profiles --check-schema user_schema.json\n"
+    "\n"
+    "  --filter    run only the cases whose name contains TEXT\n"
+    "  --sizes     comma-separated profile counts (default 1000,100000)\n"
+    "  --min-time  timed milliseconds per case (default 200)\n"
+    "  --baseline  add the ratios to an earlier report\n"
+    "  --output    write the report there instead of standard output\n"
+    "  --check-schema  check the OSVRUser field table against the schema\n"
+    "                  and exit; the build runs this\n";
+
+/// Written to the working directory, and removed at exit.
+static const char databasePath[] = "bench_profiles.db";
+
+/// Lookups per timed pass.
+static const size_t lookups = 1024;
+
+/// The profiles of one run, in every form the cases read them from.
+struct Profiles {
+  UserProfileStore store;
+  ProfileDatabase database;
+  /// Names to look up, in random order.
+  std::vector<std::string> names;
+  /// osvr_user_settings.json of the first few users.
+  std::vector<std::string> files;
+};
+
+static void makeProfiles(size_t count, Profiles& profiles) {
+  Random random;
+  profiles.store.clear();
+  for (size_t index = 0; index < count; ++index) {
+    char name[32];
+    sprintf(name, "operator%06u", static_cast<unsigned int>(index));
+    OSVRUser user;
+    user.setGender(random.next() % 2 ? "Male" : "Female");
+    user.setEye(OS, true, random.real(28, 36), random.real(-6, 6),
+                random.real(-2, 0), random.next() % 180, random.real(0, 3));
+    user.setEye(OD, false, random.real(28, 36), random.real(-6, 6),
+                random.real(-2, 0), random.next() % 180, random.real(0, 3));
+    user.setStandingEyeHeight(random.real(1.4, 2.0));
+    user.setSeatedEyeHeight(random.real(1.0, 1.4));
+    profiles.store.add(name, user);
+  }
+
+  std::string error;
+  if (!ProfileDatabase::write(databasePath, profiles.store, &error) ||
+      !profiles.database.open(databasePath, &error))
+    fprintf(stderr, "%s\n", error.c_str());
+
+  profiles.names.clear();
+  for (size_t lookup = 0; lookup < lookups; ++lookup)
+    profiles.names.push_back(profiles.store.name(
+        (random.next() * 32768u + random.next()) % count));
+
+  profiles.files.clear();
+  for (size_t index = 0; index < lookups && index < count; ++index) {
+    Json::Value settings;
+    profiles.store.user(index).write(settings);
+    profiles.files.push_back(Json::StyledWriter().write(settings));
+  }
+}
+
+// Cases
+// //////////////////////////////////////////////////////////////////
+
+static void benchDatabaseOpen(State& state, Profiles& profiles) {
+  state.setItemsPerPass(1);
+  ProfileDatabase database;
+  while (state.keepRunning()) {
+    sink += database.open(databasePath);
+    sink += database.size();
+    database.close();
+  }
+  (void)profiles;
+}
+
+static void benchDatabaseLookup(State& state, Profiles& profiles) {
+  state.setItemsPerPass(lookups);
+  while (state.keepRunning()) {
+    for (size_t lookup = 0; lookup < lookups; ++lookup) {
+      size_t index = profiles.database.find(profiles.names[lookup]);
+      sink += size_t(profiles.database.user(index).pupilDistance(OS));
+    }
+  }
+}
+
+static void benchStoreLookup(State& state, Profiles& profiles) {
+  state.setItemsPerPass(lookups);
+  while (state.keepRunning()) {
+    for (size_t lookup = 0; lookup < lookups; ++lookup) {
+      size_t index = profiles.store.indexOf(profiles.names[lookup]);
+      sink += size_t(profiles.store.user(index).pupilDistance(OS));
+    }
+  }
+}
+
+/// One user's settings file parsed and read, per profile.
+static void benchJsonFile(State& state, Profiles& profiles) {
+  state.setItemsPerPass(profiles.files.size());
+  Json::Reader reader;
+  while (state.keepRunning()) {
+    for (size_t file = 0; file < profiles.files.size(); ++file) {
+      Json::Value settings;
+      reader.parse(profiles.files[file], settings, false);
+      OSVRUser user;
+      user.read(settings);
+      sink += size_t(user.pupilDistance(OS));
+    }
+  }
+}
+
+typedef void (*BenchFunction)(State& state, Profiles& profiles);
+
+static const struct {
+  const char* name;
+  BenchFunction run;
+} benchmarks[] = {
+  { "database.open", benchDatabaseOpen },
+  { "database.lookup", benchDatabaseLookup },
+  { "store.lookup", benchStoreLookup },
+  { "json.file", benchJsonFile },
+};
+
+/// The profiles benchmarked here are laid out by the OSVRUser field table,
+/// so check that it still matches the schema the settings files follow.
+static int checkSchema(const std::string& path) {
+  std::ifstream file(path.c_str(), std::ifstream::binary);
+  Json::Value schema;
+  Json::Reader reader;
+  if (!file || !reader.parse(file, schema)) {
+    fprintf(stderr,
+            "Cannot read the schema %s\n%s",
+            path.c_str(),
+            reader.getFormattedErrorMessages().c_str());
+    return 1;
+  }
+  std::string errors;
+  if (!OSVRUser::checkSchema(schema, &errors)) {
+    fprintf(stderr,
+            "%s: the OSVRUser field table does not match:\n%s",
+            path.c_str(),
+            errors.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  JsonBench::Options options;
+  if (!JsonBench::parseOptions(argc, argv, options, usage))
+    return 2;
+  if (!options.schema.empty())
+    return checkSchema(options.schema);
+  if (options.sizes.empty()) {
+    options.sizes.push_back(1000);
+    options.sizes.push_back(100000);
+  }
+
+  JsonBench::Report report("bench_profiles", options);
+  for (size_t size = 0; size < options.sizes.size(); ++size) {
+    Profiles profiles;
+    makeProfiles(options.sizes[size], profiles);
+    for (size_t bench = 0; bench < sizeof(benchmarks) / sizeof(benchmarks[0]);
+         ++bench) {
+      if (std::string(benchmarks[bench].name).find(options.filter) ==
+          std::string::npos)
+        continue;
+      State state(options.sizes[size], options.minTimeNs);
+      benchmarks[bench].run(state, profiles);
+      Json::Value result = state.result();
+      result["name"] = benchmarks[bench].name;
+      result["size"] = Json::UInt64(options.sizes[size]);
+      report.add(result);
+    }
+  }
+  remove(databasePath);
+  return report.write();
+}
@@ -0,0 +1,394 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+/* End-to-end throughput of the readers and writers over a corpus: the
+ * configuration files this repository ships, plus generated documents shaped
+ * like the big ones OSVR deals with. Reports MB/s, documents/s and, for the
+ * readers, allocations per document as JSON; see bench_value.cpp for the
+ * options shared with the other benchmark.
+ */
+
+#include "bench.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+using JsonBench::Random;
+using JsonBench::State;
+using JsonBench::sink;
+
+static const char usage[] =
+    "Usage: bench_readwrite [--filter TEXT] [--min-time MS] [--data DIR]\n"
+    "                       [--baseline REPORT] [--output FILE]\n"
+    "                       [--write-corpus DIR]\n"
+    "\n"
+    "  --filter        run only the cases whose name or document contains "
+    "TEXT\n"
+    "  --min-time      timed milliseconds per case (default 200)\n"
+    "  --data          checkout holding osvr_user_settings.json and\n"
+    "                  usersettingsplugin/osvr_server_config.json\n"
+    "  --baseline      add the ratios to an earlier report\n"
+    "  --output        write the report there instead of standard output\n"
+    "  --write-corpus  save every corpus document in DIR and exit\n";
+
+#if !defined(BENCH_DATA_DIR)
+#define BENCH_DATA_DIR ".."
+#endif
+
+struct CorpusFile {
+  std::string name;
+  std::string text;
+};
+
+// Corpus
+// //////////////////////////////////////////////////////////////////
+
+static std::string format(const char* pattern, unsigned int a, unsigned int b) {
+  char text[128];
+  sprintf(text, pattern, a, b);
+  return text;
+}
+
+/// A display descriptor with a point-sampled distortion mesh, as produced by
+/// the HDK calibration tools: most of it is short arrays of reals.
+static void makeDisplayConfig(Json::Value& root, Random& random) {
+  Json::Value& hmd = root["hmd"];
+  hmd["device"]["vendor"] = "OSVR";
+  hmd["device"]["model"] = "HDK";
+  hmd["device"]["Version"] = "1.3";
+  hmd["field_of_view"]["monocular_horizontal"] = 90;
+  hmd["field_of_view"]["monocular_vertical"] = 101.25;
+  hmd["resolutions"].append(Json::Value(Json::objectValue));
+  hmd["resolutions"][0]["width"] = 1920;
+  hmd["resolutions"][0]["height"] = 1080;
+  hmd["resolutions"][0]["video_inputs"] = 1;
+  hmd["resolutions"][0]["display_mode"] = "horz_side_by_side";
+  Json::Value& distortion = hmd["distortion"];
+  distortion["type"] = "mono_point_samples";
+  Json::Value& samples = distortion["mono_point_samples"];
+  for (int eye = 0; eye < 2; ++eye) {
+    Json::Value& mesh = samples.append(Json::Value(Json::arrayValue));
+    for (int row = 0; row < 64; ++row) {
+      for (int column = 0; column < 64; ++column) {
+        Json::Value& sample = mesh.append(Json::Value(Json::arrayValue));
+        Json::Value& from = sample.append(Json::Value(Json::arrayValue));
+        from.append(column / 63.0);
+        from.append(row / 63.0);
+        Json::Value& to = sample.append(Json::Value(Json::arrayValue));
+        to.append(column / 63.0 + random.real(-0.02, 0.02));
+        to.append(row / 63.0 + random.real(-0.02, 0.02));
+      }
+    }
+  }
+}
+
+/// A tracker calibration log: many small records of mixed scalars.
+static void makeCalibration(Json::Value& root, Random& random) {
+  root["device"] = "com_osvr_VideoBasedHMDTracker";
+  root["cameraMatrix"] = Json::Value(Json::arrayValue);
+  for (int index = 0; index < 9; ++index)
+    root["cameraMatrix"].append(random.real(-700, 700));
+  Json::Value& samples = root["samples"];
+  for (unsigned int index = 0; index < 8000; ++index) {
+    Json::Value& sample = samples.append(Json::Value(Json::objectValue));
+    sample["timestamp"] = Json::UInt64(1470000000000ull + index * 16);
+    sample["valid"] = random.next() % 16 != 0;
+    sample["beacons"] = random.next() % 40;
+    Json::Value& position = sample["position"];
+    for (int axis = 0; axis < 3; ++axis)
+      position.append(random.real(-2, 2));
+    Json::Value& orientation = sample["orientation"];
+    for (int axis = 0; axis < 4; ++axis)
+      orientation.append(random.real(-1, 1));
+  }
+}
+
+/// Server aliases: long path strings, some with characters to escape.
+static void makeAliasTable(Json::Value& root, Random& random) {
+  static const char* const devices[] = {
+    "com_osvr_Multiserver/OSVRHackerDevKitPrediction0",
+    "com_osvr_VideoBasedHMDTracker/TrackedCamera0_0",
+    "com_osvr_Vive/Vive0", "org_osvr_filter_onehandsmoothing/Smoothed \"hand\"",
+  };
+  Json::Value& aliases = root["aliases"];
+  for (unsigned int index = 0; index < 12000; ++index) {
+    std::string target = std::string("/") + devices[random.next() % 4] +
+                         format("/semantic/body/%u/joint%u",
+                                random.next() % 100,
+                                index);
+    if (random.next() % 8 == 0)
+      target += "/caf\xc3\xa9\ttab";
+    aliases[format("/me/body/%u/joint%u", index % 100, index)] = target;
+  }
+}
+
+/// Containers nested hundreds of levels deep, a few times over.
+static void makeDeepNesting(Json::Value& root, Random& random) {
+  root = Json::Value(Json::arrayValue);
+  for (int tree = 0; tree < 16; ++tree) {
+    Json::Value* current = &root.append(Json::Value(Json::objectValue));
+    for (int depth = 1; depth < 256; ++depth) {
+      Json::ValueType type = depth % 2 ? Json::arrayValue : Json::objectValue;
+      if (current->isObject()) {
+        if (random.next() % 4 == 0)
+          (*current)["depth"] = depth;
+        current = &((*current)["child"] = Json::Value(type));
+      } else {
+        if (random.next() % 4 == 0)
+          current->append(depth);
+        current = &current->append(Json::Value(type));
+      }
+    }
+  }
+}
+
+/// Flat arrays of integers and reals.
+static void makeNumberArrays(Json::Value& root, Random& random) {
+  Json::Value& integers = root["integers"];
+  for (int index = 0; index < 60000; ++index)
+    integers.append(int(random.next()) - 16384);
+  Json::Value& reals = root["reals"];
+  for (int index = 0; index < 60000; ++index)
+    reals.append(random.real(-1000, 1000));
+}
+
+static bool readFile(const std::string& path, std::string& text) {
+  std::ifstream file(path.c_str(), std::ifstream::binary);
+  if (!file)
+    return false;
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  text = stream.str();
+  return true;
+}
+
+static void makeCorpus(const JsonBench::Options& options,
+                       std::vector<CorpusFile>& corpus) {
+  std::string dataDir = options.dataDir.empty() ? BENCH_DATA_DIR
+                                                : options.dataDir;
+  static const char* const files[][2] = {
+    { "user-settings", "/osvr_user_settings.json" },
+    { "server-config", "/usersettingsplugin/osvr_server_config.json" },
+  };
+  for (size_t file = 0; file < sizeof(files) / sizeof(files[0]); ++file) {
+    CorpusFile document;
+    document.name = files[file][0];
+    if (readFile(dataDir + files[file][1], document.text))
+      corpus.push_back(document);
+    else
+      fprintf(stderr,
+              "Skipping %s: cannot read %s%s\n",
+              files[file][0],
+              dataDir.c_str(),
+              files[file][1]);
+  }
+
+  typedef void (*Generator)(Json::Value& root, Random& random);
+  static const struct {
+    const char* name;
+    Generator generate;
+  } generated[] = {
+    { "display-config", makeDisplayConfig },
+    { "calibration", makeCalibration },
+    { "alias-table", makeAliasTable },
+    { "deep-nesting", makeDeepNesting },
+    { "number-arrays", makeNumberArrays },
+  };
+  for (size_t index = 0; index < sizeof(generated) / sizeof(generated[0]);
+       ++index) {
+    Random random;
+    Json::Value root;
+    generated[index].generate(root, random);
+    CorpusFile document;
+    document.name = generated[index].name;
+    // Indented like the configuration files people edit.
+    document.text = Json::StyledWriter().write(root);
+    corpus.push_back(document);
+  }
+}
+
+// Cases
+// //////////////////////////////////////////////////////////////////
+
+/// Parse the document once, for the writer cases.
+static void parse(const CorpusFile& document, Json::Value& root) {
+  Json::Reader reader;
+  const char* begin = document.text.data();
+  if (!reader.parse(begin, begin + document.text.size(), root))
+    fprintf(stderr,
+            "%s does not parse:\n%s",
+            document.name.c_str(),
+            reader.getFormattedErrorMessages().c_str());
+}
+
+static size_t benchReader(State& state,
+                          const CorpusFile& document,
+                          const Json::Features& features) {
+  const char* begin = document.text.data();
+  const char* end = begin + document.text.size();
+  Json::Reader reader(features);
+  while (state.keepRunning()) {
+    Json::Value root;
+    sink += reader.parse(begin, end, root, false);
+    state.pauseTiming();
+    Json::Value().swap(root);
+    state.resumeTiming();
+  }
+  return document.text.size();
+}
+
+static size_t benchReaderDefault(State& state, const CorpusFile& document) {
+  return benchReader(state, document, Json::Features::all());
+}
+
+static size_t benchReaderLazy(State& state, const CorpusFile& document) {
+  Json::Features features = Json::Features::all();
+  features.lazyNumbers_ = true;
+  return benchReader(state, document, features);
+}
+
+static size_t benchCharReader(State& state,
+                              const CorpusFile& document,
+                              bool useArena) {
+  const char* begin = document.text.data();
+  const char* end = begin + document.text.size();
+  Json::CharReaderBuilder builder;
+  builder.useArena_ = useArena;
+  Json::CharReader* reader = builder.newCharReader();
+  Json::Document parsed;
+  while (state.keepRunning()) {
+    sink += reader->parse(begin, end, &parsed, 0);
+    state.pauseTiming();
+    parsed.clear();
+    state.resumeTiming();
+  }
+  delete reader;
+  return document.text.size();
+}
+
+static size_t benchCharReaderHeap(State& state, const CorpusFile& document) {
+  return benchCharReader(state, document, false);
+}
+
+static size_t benchCharReaderArena(State& state,
+                                   const CorpusFile& document) {
+  return benchCharReader(state, document, true);
+}
+
+static size_t benchFastWriter(State& state, const CorpusFile& document) {
+  Json::Value root;
+  parse(document, root);
+  Json::FastWriter writer;
+  size_t bytes = 0;
+  while (state.keepRunning())
+    bytes = writer.write(root).size();
+  return bytes;
+}
+
+static size_t benchStyledWriter(State& state, const CorpusFile& document) {
+  Json::Value root;
+  parse(document, root);
+  Json::StyledWriter writer;
+  size_t bytes = 0;
+  while (state.keepRunning())
+    bytes = writer.write(root).size();
+  return bytes;
+}
+
+static size_t benchStyledStreamWriter(State& state,
+                                      const CorpusFile& document) {
+  Json::Value root;
+  parse(document, root);
+  Json::StyledStreamWriter writer;
+  size_t bytes = 0;
+  while (state.keepRunning()) {
+    std::ostringstream stream;
+    writer.write(stream, root);
+    bytes = size_t(stream.tellp());
+  }
+  return bytes;
+}
+
+static size_t benchStreamWriterBuilder(State& state,
+                                       const CorpusFile& document) {
+  Json::Value root;
+  parse(document, root);
+  Json::StreamWriterBuilder builder;
+  size_t bytes = 0;
+  while (state.keepRunning())
+    bytes = Json::writeString(root, builder).size();
+  return bytes;
+}
+
+/// Run one case; return the bytes read or written per document.
+typedef size_t (*BenchFunction)(State& state, const CorpusFile& document);
+
+static const struct {
+  const char* name;
+  BenchFunction run;
+  /// The writers build std::strings and streams, which do not go through
+  /// the MemoryHooks, so State counts nothing for them.
+  bool countsAllocations;
+} benchmarks[] = {
+  { "read.Reader", benchReaderDefault, true },
+  { "read.Reader.lazyNumbers", benchReaderLazy, true },
+  { "read.CharReaderBuilder", benchCharReaderHeap, true },
+  { "read.CharReaderBuilder.arena", benchCharReaderArena, true },
+  { "write.FastWriter", benchFastWriter, false },
+  { "write.StyledWriter", benchStyledWriter, false },
+  { "write.StyledStreamWriter", benchStyledStreamWriter, false },
+  { "write.StreamWriterBuilder", benchStreamWriterBuilder, false },
+};
+
+int main(int argc, char* argv[]) {
+  JsonBench::Options options;
+  if (!JsonBench::parseOptions(argc, argv, options, usage))
+    return 2;
+
+  std::vector<CorpusFile> corpus;
+  makeCorpus(options, corpus);
+  if (!options.corpusDir.empty()) {
+    for (size_t index = 0; index < corpus.size(); ++index) {
+      std::string path = options.corpusDir + "/" + corpus[index].name + ".json";
+      std::ofstream file(path.c_str(), std::ofstream::binary);
+      file << corpus[index].text;
+      if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  JsonBench::Report report("bench_readwrite", options);
+  for (size_t bench = 0; bench < sizeof(benchmarks) / sizeof(benchmarks[0]);
+       ++bench) {
+    for (size_t index = 0; index < corpus.size(); ++index) {
+      const CorpusFile& document = corpus[index];
+      if (std::string(benchmarks[bench].name).find(options.filter) ==
+              std::string::npos &&
+          document.name.find(options.filter) == std::string::npos)
+        continue;
+      State state(1, options.minTimeNs);
+      size_t bytes = benchmarks[bench].run(state, document);
+      Json::Value result = state.result();
+      double nsPerDocument = result["nsPerItem"].asDouble();
+      result["name"] = benchmarks[bench].name;
+      result["document"] = document.name;
+      result["bytes"] = Json::UInt64(bytes);
+      if (!benchmarks[bench].countsAllocations) {
+        result["allocations"] = Json::Value();
+        result["releases"] = Json::Value();
+        result["peakBytes"] = Json::Value();
+      }
+      if (nsPerDocument > 0) {
+        result["mbPerSecond"] = double(bytes) * 1e3 / nsPerDocument;
+        result["documentsPerSecond"] = 1e9 / nsPerDocument;
+      }
+      report.add(result);
+    }
+  }
+  return report.write();
+}
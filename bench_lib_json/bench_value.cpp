@@ -0,0 +1,421 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+/* Microbenchmarks of Json::Value: construction, object insert and lookup,
+ * array append and index, copy, iteration and destruction, and comparing
+ * identical trees, trees differing in their last leaf and trees differing
+ * in every leaf, over trees of several shapes and sizes. The patch cases
+ * diff and patch such trees after a few of their leaves changed. The
+ * report also gives sizeof(Value) and, where perf events are available,
+ * cache misses per item. Results go out as JSON; pass an earlier report
+ * with --baseline to compare two builds.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+
+using JsonBench::State;
+using JsonBench::sink;
+
+static const char usage[] =
+    "Usage: bench_value [--filter TEXT] [--shapes LIST] [--sizes LIST]\n"
+    "                   [--min-time MS] [--baseline REPORT] [--output FILE]\n"
+    "\n"
+    "  --filter    run only the cases whose name contains TEXT\n"
+    "  --shapes    comma-separated: flat-object,flat-array,records,deep\n"
+    "              (deep stops at 2048 levels)\n"
+    "  --sizes     comma-separated element counts (default 16,1024,65536)\n"
+    "  --min-time  timed milliseconds per case (default 200)\n"
+    "  --baseline  add the ratios to an earlier report\n"
+    "  --output    write the report there instead of standard output\n";
+
+// Nesting deeper than this would overflow the stack of the recursive copy
+// and destructor, so the deep shape stops there.
+static const size_t maxDepth = 2048;
+
+static std::string memberName(size_t index) {
+  char name[32];
+  sprintf(name, "member%u", unsigned(index));
+  return name;
+}
+
+/// Fill \a value with a tree of the given shape holding \a size elements.
+static void makeShape(Json::Value& value,
+                      const std::string& shape,
+                      size_t size) {
+  if (shape == "flat-object") {
+    value = Json::Value(Json::objectValue);
+    for (size_t index = 0; index < size; ++index)
+      value[memberName(index)] = Json::UInt(index);
+  } else if (shape == "flat-array") {
+    value = Json::Value(Json::arrayValue);
+    for (size_t index = 0; index < size; ++index)
+      value.append(Json::UInt(index));
+  } else if (shape == "records") {
+    // Shaped like the user profiles the settings tool stores.
+    value = Json::Value(Json::arrayValue);
+    for (size_t index = 0; index < size; ++index) {
+      Json::Value& record = value.append(Json::Value(Json::objectValue));
+      record["id"] = Json::UInt(index);
+      record["name"] = "user " + memberName(index);
+      record["gender"] = index % 2 ? "Female" : "Male";
+      record["standingEyeHeight"] = 1.6 + double(index % 40) / 100;
+      Json::Value& eyes = record["eyes"];
+      eyes["left"]["pupilDistance"] = 31.5 + double(index % 8) / 4;
+      eyes["left"]["dominant"] = index % 3 == 0;
+      eyes["right"]["pupilDistance"] = 32.0 + double(index % 8) / 4;
+      eyes["right"]["dominant"] = index % 3 != 0;
+      Json::Value& tags = record["tags"];
+      tags.append("hmd");
+      tags.append("seated");
+    }
+  } else if (shape == "deep") {
+    value = Json::Value(Json::objectValue);
+    Json::Value* current = &value;
+    for (size_t depth = 1; depth < size && depth < maxDepth; ++depth)
+      current = &(*current)["child"];
+    (*current)["leaf"] = true;
+  } else {
+    fprintf(stderr, "Unknown shape %s\n", shape.c_str());
+  }
+}
+
+/// Number of Values in the tree.
+static size_t countValues(const Json::Value& value) {
+  size_t count = 1;
+  for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it)
+    count += countValues(*it);
+  return count;
+}
+
+// Whole-tree cases: one pass handles one tree, and items are its Values.
+// //////////////////////////////////////////////////////////////////
+
+static void benchConstruct(State& state, const std::string& shape) {
+  Json::Value value;
+  makeShape(value, shape, state.size());
+  state.setItemsPerPass(countValues(value));
+  while (state.keepRunning()) {
+    makeShape(value, shape, state.size());
+    sink += value.size();
+    state.pauseTiming();
+    Json::Value().swap(value);
+    state.resumeTiming();
+  }
+}
+
+static void benchDestroy(State& state, const std::string& shape) {
+  Json::Value value;
+  makeShape(value, shape, state.size());
+  state.setItemsPerPass(countValues(value));
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    makeShape(value, shape, state.size());
+    state.resumeTiming();
+    Json::Value().swap(value);
+  }
+}
+
+static void benchCopy(State& state, const std::string& shape) {
+  Json::Value source;
+  makeShape(source, shape, state.size());
+  state.setItemsPerPass(countValues(source));
+  while (state.keepRunning()) {
+    Json::Value copy(source);
+    sink += copy.size();
+    state.pauseTiming();
+    Json::Value().swap(copy);
+    state.resumeTiming();
+  }
+}
+
+/// The last leaf in iteration order, which compare() reaches last.
+static Json::Value& lastLeaf(Json::Value& value) {
+  Json::Value* leaf = &value;
+  while (leaf->size()) {
+    Json::Value::iterator last = leaf->end();
+    leaf = &*--last;
+  }
+  return *leaf;
+}
+
+/// Give every leaf of the tree a value no leaf of makeShape() has.
+static void changeLeaves(Json::Value& value) {
+  if (!value.size()) {
+    value = "changed";
+    return;
+  }
+  for (Json::Value::iterator it = value.begin(); it != value.end(); ++it)
+    changeLeaves(*it);
+}
+
+enum Difference { identical, lastLeafDiffers, everyLeafDiffers };
+
+static void benchCompare(State& state,
+                         const std::string& shape,
+                         Difference difference) {
+  // Built apart rather than copied, so no state is shared between the two.
+  Json::Value a, b;
+  makeShape(a, shape, state.size());
+  makeShape(b, shape, state.size());
+  if (difference == lastLeafDiffers)
+    lastLeaf(b) = "changed";
+  else if (difference == everyLeafDiffers)
+    changeLeaves(b);
+  state.setItemsPerPass(countValues(a));
+  while (state.keepRunning())
+    sink += a.compare(b) == 0;
+}
+
+static void benchCompareIdentical(State& state, const std::string& shape) {
+  benchCompare(state, shape, identical);
+}
+
+static void benchCompareLastLeaf(State& state, const std::string& shape) {
+  benchCompare(state, shape, lastLeafDiffers);
+}
+
+static void benchCompareEveryLeaf(State& state, const std::string& shape) {
+  benchCompare(state, shape, everyLeafDiffers);
+}
+
+// Patch cases: one pass diffs or patches a whole tree of which a few
+// leaves changed, and items are its Values.
+// //////////////////////////////////////////////////////////////////
+
+static const size_t changedLeaves = 4;
+
+static void collectLeaves(Json::Value& value,
+                          std::vector<Json::Value*>& leaves) {
+  if (!value.size()) {
+    leaves.push_back(&value);
+    return;
+  }
+  for (Json::Value::iterator it = value.begin(); it != value.end(); ++it)
+    collectLeaves(*it, leaves);
+}
+
+/// Change changedLeaves leaves, spread over the tree.
+static void changeSomeLeaves(Json::Value& value) {
+  std::vector<Json::Value*> leaves;
+  collectLeaves(value, leaves);
+  for (size_t index = 0; index < changedLeaves; ++index)
+    *leaves[index * leaves.size() / changedLeaves] = "changed";
+}
+
+static void benchMakePatch(State& state, const std::string& shape) {
+  Json::Value before, after;
+  makeShape(before, shape, state.size());
+  makeShape(after, shape, state.size());
+  changeSomeLeaves(after);
+  state.setItemsPerPass(countValues(before));
+  while (state.keepRunning())
+    sink += Json::makePatch(before, after).size();
+}
+
+static void benchApplyPatch(State& state, const std::string& shape) {
+  Json::Value before, after;
+  makeShape(before, shape, state.size());
+  makeShape(after, shape, state.size());
+  changeSomeLeaves(after);
+  Json::Value patch = Json::makePatch(before, after);
+  // Undone by patch rather than by copy, which would cost far more than
+  // the few changes timed
+  Json::Value undo = Json::makePatch(after, before);
+  state.setItemsPerPass(countValues(before));
+  Json::Value target(before);
+  while (state.keepRunning()) {
+    sink += Json::applyPatch(target, patch, 0);
+    state.pauseTiming();
+    Json::applyPatch(target, undo, 0);
+    state.resumeTiming();
+  }
+}
+
+static void benchMakeMergePatch(State& state, const std::string& shape) {
+  Json::Value before, after;
+  makeShape(before, shape, state.size());
+  makeShape(after, shape, state.size());
+  changeSomeLeaves(after);
+  state.setItemsPerPass(countValues(before));
+  while (state.keepRunning())
+    sink += Json::makeMergePatch(before, after).size();
+}
+
+static void benchApplyMergePatch(State& state, const std::string& shape) {
+  Json::Value before, after;
+  makeShape(before, shape, state.size());
+  makeShape(after, shape, state.size());
+  changeSomeLeaves(after);
+  Json::Value patch = Json::makeMergePatch(before, after);
+  Json::Value undo = Json::makeMergePatch(after, before);
+  state.setItemsPerPass(countValues(before));
+  Json::Value target(before);
+  while (state.keepRunning()) {
+    Json::applyMergePatch(target, patch);
+    sink += target.size();
+    state.pauseTiming();
+    Json::applyMergePatch(target, undo);
+    state.resumeTiming();
+  }
+}
+
+static void benchIterate(State& state, const std::string& shape) {
+  Json::Value value;
+  makeShape(value, shape, state.size());
+  state.setItemsPerPass(countValues(value));
+  while (state.keepRunning())
+    sink += countValues(value);
+}
+
+// Element cases: one pass handles size() members or elements.
+// //////////////////////////////////////////////////////////////////
+
+static void benchInsertString(State& state, const std::string&) {
+  std::vector<std::string> names;
+  for (size_t index = 0; index < state.size(); ++index)
+    names.push_back(memberName(index));
+  while (state.keepRunning()) {
+    Json::Value object(Json::objectValue);
+    for (size_t index = 0; index < names.size(); ++index)
+      object[names[index]] = Json::UInt(index);
+    sink += object.size();
+    state.pauseTiming();
+    Json::Value().swap(object);
+    state.resumeTiming();
+  }
+}
+
+static void benchInsertKey(State& state, const std::string&) {
+  std::vector<Json::Key> names;
+  for (size_t index = 0; index < state.size(); ++index)
+    names.push_back(Json::Key(memberName(index)));
+  while (state.keepRunning()) {
+    Json::Value object(Json::objectValue);
+    for (size_t index = 0; index < names.size(); ++index)
+      object[names[index]] = Json::UInt(index);
+    sink += object.size();
+    state.pauseTiming();
+    Json::Value().swap(object);
+    state.resumeTiming();
+  }
+}
+
+static void benchFindString(State& state, const std::string&) {
+  Json::Value object;
+  makeShape(object, "flat-object", state.size());
+  std::vector<std::string> names;
+  for (size_t index = 0; index < state.size(); ++index)
+    names.push_back(memberName(index));
+  const Json::Value& constObject = object;
+  while (state.keepRunning()) {
+    for (size_t index = 0; index < names.size(); ++index)
+      sink += constObject[names[index]].asUInt();
+  }
+}
+
+static void benchFindKey(State& state, const std::string&) {
+  Json::Value object;
+  makeShape(object, "flat-object", state.size());
+  std::vector<Json::Key> names;
+  for (size_t index = 0; index < state.size(); ++index)
+    names.push_back(Json::Key(memberName(index)));
+  while (state.keepRunning()) {
+    for (size_t index = 0; index < names.size(); ++index)
+      sink += object.find(names[index])->asUInt();
+  }
+}
+
+static void benchAppend(State& state, const std::string&) {
+  while (state.keepRunning()) {
+    Json::Value array(Json::arrayValue);
+    for (size_t index = 0; index < state.size(); ++index)
+      array.append(Json::UInt(index));
+    sink += array.size();
+    state.pauseTiming();
+    Json::Value().swap(array);
+    state.resumeTiming();
+  }
+}
+
+static void benchIndex(State& state, const std::string&) {
+  Json::Value array;
+  makeShape(array, "flat-array", state.size());
+  const Json::Value& constArray = array;
+  while (state.keepRunning()) {
+    for (Json::ArrayIndex index = 0; index < constArray.size(); ++index)
+      sink += constArray[index].asUInt();
+  }
+}
+
+typedef void (*BenchFunction)(State& state, const std::string& shape);
+
+struct Benchmark {
+  const char* name;
+  /// Run on every shape; the others build their own input from size().
+  bool everyShape;
+  BenchFunction run;
+};
+
+static const Benchmark benchmarks[] = {
+  { "value.construct", true, benchConstruct },
+  { "value.destroy", true, benchDestroy },
+  { "value.copy", true, benchCopy },
+  { "value.compare.identical", true, benchCompareIdentical },
+  { "value.compare.lastLeaf", true, benchCompareLastLeaf },
+  { "value.compare.everyLeaf", true, benchCompareEveryLeaf },
+  { "value.iterate", true, benchIterate },
+  { "patch.make", true, benchMakePatch },
+  { "patch.apply", true, benchApplyPatch },
+  { "mergePatch.make", true, benchMakeMergePatch },
+  { "mergePatch.apply", true, benchApplyMergePatch },
+  { "object.insert.string", false, benchInsertString },
+  { "object.insert.key", false, benchInsertKey },
+  { "object.find.string", false, benchFindString },
+  { "object.find.key", false, benchFindKey },
+  { "array.append", false, benchAppend },
+  { "array.index", false, benchIndex },
+};
+
+int main(int argc, char* argv[]) {
+  JsonBench::Options options;
+  options.sizes.push_back(16);
+  options.sizes.push_back(1024);
+  options.sizes.push_back(65536);
+  options.shapes.push_back("flat-object");
+  options.shapes.push_back("flat-array");
+  options.shapes.push_back("records");
+  options.shapes.push_back("deep");
+  if (!JsonBench::parseOptions(argc, argv, options, usage))
+    return 2;
+
+  JsonBench::Report report("bench_value", options);
+  // Every node of every tree costs this much before its payload
+  report.note("sizeofValue", Json::UInt64(sizeof(Json::Value)));
+  fprintf(stderr, "sizeof(Json::Value) = %u bytes\n",
+          unsigned(sizeof(Json::Value)));
+  for (size_t bench = 0; bench < sizeof(benchmarks) / sizeof(benchmarks[0]);
+       ++bench) {
+    const Benchmark& benchmark = benchmarks[bench];
+    if (std::string(benchmark.name).find(options.filter) == std::string::npos)
+      continue;
+    std::vector<std::string> shapes(1, "");
+    if (benchmark.everyShape)
+      shapes = options.shapes;
+    for (size_t shape = 0; shape < shapes.size(); ++shape) {
+      for (size_t size = 0; size < options.sizes.size(); ++size) {
+        State state(options.sizes[size], options.minTimeNs);
+        benchmark.run(state, shapes[shape]);
+        Json::Value result = state.result();
+        result["name"] = benchmark.name;
+        if (!shapes[shape].empty())
+          result["shape"] = shapes[shape];
+        result["size"] = Json::UInt64(options.sizes[size]);
+        report.add(result);
+      }
+    }
+  }
+  return report.write();
+}
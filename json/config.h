@@ -87,6 +87,15 @@
 #define JSONCPP_DEPRECATED(message)
 #endif // if !defined(JSONCPP_DEPRECATED)
 
+// If JSON_NO_THREADS is defined, Json does not lock its process-wide tables
+// and must then be used from a single thread. It is implied when the
+// compiler has no C++11 <mutex>.
+// #define JSON_NO_THREADS 1
+#if !defined(JSON_NO_THREADS) &&                                              \
+    (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define JSON_HAS_THREADS 1
+#endif // if !defined(JSON_NO_THREADS) && ...
+
 namespace Json {
 typedef int Int;
 typedef unsigned int UInt;
@@ -50,6 +50,27 @@ public:
 
   /// \c true if numeric object key are allowed. Default: \c false.
   bool allowNumericKeys_;
+
+  /// \c true if the Reader records the source offsets of each Value (see
+  /// Value::getOffsetStart()). Reader::pushError() needs them. Each Value
+  /// with offsets takes an entry in the side table, so readers that never
+  /// report locations may turn this off. Ignored when reading into an arena
+  /// Document. Default: \c true.
+  bool collectOffsets_;
+
+  /// \c true if the Reader shares object member names through the process-wide
+  /// pool behind Json::Key instead of giving every member its own copy. Pooled
+  /// names are never freed, so only enable this for documents whose member
+  /// names come from a bounded set. Default: \c false.
+  bool internKeys_;
+
+  /// \c true if the Reader keeps real numbers as their source text and only
+  /// converts one when it is first read. Writers then print the number exactly
+  /// as it was read. Numbers outside the RFC 8259 grammar, such as "1." or
+  /// "2.5e+", are still converted at once, so that the output stays valid
+  /// JSON. The conversion is safe to race on from const accessors.
+  /// Default: \c false.
+  bool lazyNumbers_;
 };
 
 } // namespace Json
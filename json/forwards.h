@@ -25,6 +25,8 @@ class Features;
 // value.h
 typedef unsigned int ArrayIndex;
 class StaticString;
+class ValueArena;
+class Document;
 class Path;
 class PathArgument;
 class Value;
@@ -38,6 +40,18 @@ class ValueInternalArray;
 class ValueInternalMap;
 #endif // #ifdef JSON_VALUE_USE_INTERNAL_MAP
 
+// pointer.h
+class CompiledPath;
+class CompiledPathSet;
+
+// snapshot.h
+class Snapshot;
+
+// parallel.h
+class WorkerPool;
+class ParallelReader;
+struct DocumentText;
+
 } // namespace Json
 
 #endif // JSON_FORWARDS_H_INCLUDED
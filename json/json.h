@@ -11,5 +11,9 @@
 #include "reader.h"
 #include "writer.h"
 #include "features.h"
+#include "pointer.h"
+#include "patch.h"
+#include "snapshot.h"
+#include "parallel.h"
 
 #endif // JSON_JSON_H_INCLUDED
@@ -0,0 +1,173 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_PARALLEL_H_INCLUDED
+#define CPPTL_JSON_PARALLEL_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "features.h"
+#include "reader.h"
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace Json {
+
+/** \brief Fixed set of threads that the parallel readers and writers share.
+ *
+ * run() hands the indices of one job out to the workers and to the calling
+ * thread, and returns once every index is done. One job runs at a time;
+ * concurrent calls to run() wait for each other.
+ *
+ * Without JSON_HAS_THREADS the pool has no workers and run() calls the task
+ * for each index in turn.
+ */
+class JSON_API WorkerPool {
+public:
+  /// Task called once for each index of a job.
+  typedef void (*Task)(void* context, size_t index);
+
+  /** \param threads Threads that work on a job, counting the one that calls
+   *                 run(); 0 for one per hardware thread.
+   */
+  explicit WorkerPool(unsigned int threads = 0);
+  ~WorkerPool();
+
+  /// Threads that work on a job, counting the caller.
+  unsigned int threads() const;
+
+  /** Call \a task(\a context, index) for every index in [0, \a count), in no
+   * particular order and on any of the threads. If a task throws, the
+   * remaining indices are skipped and the first exception is rethrown here.
+   * A task must not call run() on the same pool.
+   */
+  void run(size_t count, Task task, void* context);
+
+private:
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+
+  struct Shared;
+  Shared* shared_;
+};
+
+/** \brief Reads a document whose root is a large array on several threads.
+ *
+ * A quick structural scan finds where the elements of the root array begin
+ * and end, without decoding them. The elements are then split into runs of
+ * about equal size, and each run is read by its own Reader on one of the
+ * pool's threads, straight into an array sized beforehand.
+ *
+ * Documents smaller than minimumSize(), whose root is not an array, or that
+ * the scan cannot split, are read on the calling thread. So is every
+ * document when the Features allow dropped null placeholders.
+ *
+ * Comments are skipped, never collected. Offsets, when the Features collect
+ * them, count from the start of the whole document. When reading fails, the
+ * document is read again by a single Reader, so the errors and their
+ * positions are exactly those the sequential Reader gives.
+ *
+ * \code
+ * Json::WorkerPool pool;
+ * Json::ParallelReader reader(pool);
+ * Json::Value session;
+ * if (!reader.parse(text.data(), text.data() + text.size(), session))
+ *   std::cerr << reader.getFormattedErrorMessages();
+ * \endcode
+ */
+class JSON_API ParallelReader {
+public:
+  explicit ParallelReader(WorkerPool& pool);
+  ParallelReader(WorkerPool& pool, const Features& features);
+
+  /** \brief Read a Value from [\a beginDoc, \a endDoc).
+   * \return \c true if the document was successfully parsed, \c false if an
+   * error occurred.
+   */
+  bool parse(const char* beginDoc, const char* endDoc, Value& root);
+
+  /// Smallest document split over the pool, in bytes. 256 KiB by default.
+  size_t minimumSize() const;
+  void setMinimumSize(size_t bytes);
+
+  /// Runs of elements the last document was split into; 0 if it was read on
+  /// one thread.
+  size_t lastRunCount() const;
+
+  /// \see Reader::getFormattedErrorMessages()
+  std::string getFormattedErrorMessages() const;
+  /// \see Reader::getStructuredErrors()
+  std::vector<Reader::StructuredError> getStructuredErrors() const;
+
+private:
+  struct ReadJob;
+  static void readRun(void* context, size_t run);
+  bool scanRootArray(const char* beginDoc, const char* endDoc);
+
+  WorkerPool& pool_;
+  Features features_;
+  size_t minimumSize_;
+  size_t runCount_;
+  bool good_;
+  /// Reads small documents, and failed ones again for their errors.
+  Reader reader_;
+  /// The root's '[', the ',' between each pair of elements, then its ']'.
+  std::vector<const char*> bounds_;
+};
+
+/// Text of one document for parseMany(): [begin_, end_).
+struct JSON_API DocumentText {
+  const char* begin_;
+  const char* end_;
+};
+
+/** \brief Read many independent documents concurrently on \a pool.
+ *
+ * The documents are handed out to the pool's threads in batches of
+ * consecutive ones. Each batch is read by one CharReader made by
+ * \a builder, so that each thread reuses its reader's buffers from one
+ * document to the next. With CharReaderBuilder::useArena_ every tree is
+ * taken from its own document's arena.
+ *
+ * Document cannot be copied, so a std::vector of them needs C++11; an array
+ * works in C++98 too:
+ * \code
+ * std::vector<Json::DocumentText> texts = ...;
+ * Json::Document* documents = new Json::Document[texts.size()];
+ * std::vector<std::string> errors(texts.size());
+ * Json::parseMany(pool, builder, &texts[0], texts.size(), documents,
+ *                 &errors[0]);
+ * ...
+ * delete[] documents;
+ * \endcode
+ *
+ * \param documents [out] \a count documents; documents[i] receives the tree
+ *                  of texts[i].
+ * \param errors [out] NULL, or \a count strings; errors[i] receives the
+ *               formatted errors of texts[i], or is emptied if it was read.
+ * \return The number of documents that failed to parse.
+ */
+JSON_API size_t parseMany(WorkerPool& pool,
+                          const CharReaderBuilder& builder,
+                          const DocumentText* texts,
+                          size_t count,
+                          Document* documents,
+                          std::string* errors);
+
+} // namespace Json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+#endif // CPPTL_JSON_PARALLEL_H_INCLUDED
@@ -0,0 +1,60 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_PATCH_H_INCLUDED
+#define CPPTL_JSON_PATCH_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string>
+
+namespace Json {
+
+/** \brief Return an <a HREF="https://tools.ietf.org/html/rfc6902">RFC 6902</a>
+ * JSON Patch that turns \a from into \a to.
+ *
+ * The result is an array of operations. Members of both objects are walked
+ * in their stored order side by side, so an unchanged subtree only costs a
+ * comparison and a changed leaf one "replace". Arrays get a common prefix and
+ * suffix trimmed; the elements in between are diffed pairwise and the rest
+ * added or removed. An insertion in the middle of an array is therefore
+ * found, but a reordering becomes a run of replacements.
+ *
+ * \code
+ * Json::Value patch = Json::makePatch(before, after);
+ * // [{"op":"replace","path":"/personalSettings/eyes/left/pupilDistance",
+ * //   "value":31.5}]
+ * \endcode
+ */
+JSON_API Value makePatch(const Value& from, const Value& to);
+
+/** \brief Apply the RFC 6902 JSON Patch \a patch to \a root.
+ *
+ * All six operations are supported. \a root is changed in place: if an
+ * operation fails, the ones before it stay applied, so apply to a copy when
+ * the original must survive a bad patch.
+ *
+ * \return true if every operation succeeded. Otherwise \a errs, if not NULL,
+ * says which one failed and why.
+ */
+JSON_API bool applyPatch(Value& root, const Value& patch, std::string* errs);
+
+/** \brief Return an <a HREF="https://tools.ietf.org/html/rfc7396">RFC 7396</a>
+ * JSON Merge Patch that turns \a from into \a to.
+ *
+ * A merge patch is an object shaped like the changed part of \a to, with
+ * null for removed members. As the RFC notes, it cannot set a member to
+ * null or change part of an array; arrays are replaced whole.
+ */
+JSON_API Value makeMergePatch(const Value& from, const Value& to);
+
+/** \brief Apply the RFC 7396 JSON Merge Patch \a patch to \a root.
+ */
+JSON_API void applyMergePatch(Value& root, const Value& patch);
+
+} // namespace Json
+
+#endif // CPPTL_JSON_PATCH_H_INCLUDED
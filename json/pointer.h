@@ -0,0 +1,157 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_POINTER_H_INCLUDED
+#define CPPTL_JSON_POINTER_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace Json {
+
+/** \brief A path to a node, parsed once and resolved many times.
+ *
+ * Two syntaxes are accepted:
+ * - an <a HREF="https://tools.ietf.org/html/rfc6901">RFC 6901</a> JSON
+ *   Pointer: "" is the root, "/eyes/left/pupilDistance" a leaf. "~1" and
+ *   "~0" stand for '/' and '~' in a member name. A token made of digits
+ *   also indexes arrays, and "-" names the element past the end.
+ * - the dotted syntax of Path, without '%' placeholders: "." is the root,
+ *   ".eyes.left.pupilDistance" a leaf, "[n]" an array element.
+ *
+ * Each step owns its member name. A path compiled once and kept, such as a
+ * static, may instead pool its names as Keys: members it creates then share
+ * the pooled text. Pooled names are never freed, so do not pool paths built
+ * from outside input.
+ *
+ * Example of usage:
+ * \code
+ * static const Json::CompiledPath pd("/personalSettings/eyes/left/pupilDistance",
+ *                                    true);
+ * const Json::Value* leaf = pd.resolve(root);
+ * \endcode
+ */
+class JSON_API CompiledPath {
+public:
+  /// The path to the root.
+  CompiledPath();
+  /// Compile \a path. Check isValid() for syntax errors. With \a poolNames,
+  /// the member names go into the Key pool for good.
+  explicit CompiledPath(const std::string& path, bool poolNames = false);
+
+  /// \c true if the path compiled.
+  bool isValid() const;
+  /// Why the path did not compile, or an empty string.
+  const std::string& error() const;
+  /// The text the path was compiled from.
+  const std::string& text() const;
+
+  /// Return the node at the path, or NULL if there is none or the path is
+  /// invalid.
+  const Value* resolve(const Value& root) const;
+  /// Same as above, for changing the node in place.
+  Value* resolve(Value& root) const;
+  /// Return the node at the path, or \a defaultValue if there is none.
+  Value resolve(const Value& root, const Value& defaultValue) const;
+  /// Create the nodes missing along the path and return the last one.
+  /// \pre isValid()
+  Value& make(Value& root) const;
+
+private:
+  friend class CompiledPathSet;
+  friend class Snapshot;
+
+  struct Step {
+    Step(const std::string& name, bool poolName);
+
+    std::string name_;
+    const char* pooled_; // name_ in the Key pool, or NULL
+    ArrayIndex index_;
+    bool isName_;   // may name an object member
+    bool isIndex_;  // may index an array
+    bool isAppend_; // "-": the element past the end of an array
+  };
+  typedef std::vector<Step> Steps;
+
+  static const Value* resolveStep(const Value& node, const Step& step);
+  void compilePointer();
+  void compileDotted();
+  void addStep(const std::string& token, bool isName, bool isIndex);
+  void invalidPath(const std::string& message, size_t location);
+
+  std::string text_;
+  bool poolNames_;
+  std::string error_;
+  Steps steps_;
+};
+
+/** \brief Resolves many CompiledPath against one root in a single traversal.
+ *
+ * The paths are merged into a prefix tree when they are added. Each
+ * resolve() then looks up a shared prefix such as "/personalSettings/eyes"
+ * once, however many paths start with it.
+ *
+ * \code
+ * Json::CompiledPathSet leaves;
+ * size_t left = leaves.add("/personalSettings/eyes/left/pupilDistance");
+ * size_t right = leaves.add("/personalSettings/eyes/right/pupilDistance");
+ * std::vector<const Json::Value*> nodes;
+ * leaves.resolve(root, nodes);
+ * \endcode
+ */
+class JSON_API CompiledPathSet {
+public:
+  CompiledPathSet();
+
+  /// Add \a path and return its index in the results of resolve().
+  /// \pre path.isValid()
+  size_t add(const CompiledPath& path);
+  /// Compile and add \a path.
+  /// \pre the path is valid
+  size_t add(const std::string& path);
+  /// Number of paths added.
+  size_t size() const;
+
+  /// Resolve every path against \a root. \a nodes receives one entry per
+  /// path, in the order they were added; it is NULL where the path does not
+  /// resolve.
+  void resolve(const Value& root, std::vector<const Value*>& nodes) const;
+
+private:
+  struct Node {
+    explicit Node(const CompiledPath::Step& step);
+
+    CompiledPath::Step step_;
+    std::vector<size_t> children_;
+    std::vector<size_t> paths_; // paths ending at this node
+  };
+  typedef std::vector<Node> Nodes;
+
+  static bool sameStep(const CompiledPath::Step& a,
+                       const CompiledPath::Step& b);
+
+  Nodes nodes_;
+  std::vector<size_t> roots_;     // nodes for the first step of the paths
+  std::vector<size_t> rootPaths_; // paths naming the root itself
+  size_t count_;
+};
+
+} // namespace Json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+#endif // CPPTL_JSON_POINTER_H_INCLUDED
@@ -100,6 +100,21 @@ public:
   /// \see Json::operator>>(std::istream&, Json::Value&).
   bool parse(std::istream& is, Value& root, bool collectComments = true);
 
+  /** \brief Read a <a HREF="http://www.json.org">JSON</a> document into a
+   * Document.
+   * \param doc [out] Receives the tree; its previous tree is dropped first.
+   * \param useArena \c true to take every node, string and member name of the
+   *                 tree from the document's arena. Comments are not
+   *                 collected in that case.
+   * \return \c true if the document was successfully parsed, \c false if an
+   * error occurred.
+   * \see Document
+   */
+  bool parse(const char* beginDoc,
+             const char* endDoc,
+             Document& doc,
+             bool useArena);
+
   /** \brief Returns a user friendly string that list errors in the parsed
    * document.
    * \return Formatted error message with the list of errors with their location
@@ -136,6 +151,8 @@ public:
    * \param message The error message.
    * \return \c true if the error was successfully added, \c false if the
    * Value offset exceeds the document size.
+   * \note The location is only known if the document was read with
+   * Features::collectOffsets_, as it is by default.
    */
   bool pushError(const Value& value, const std::string& message);
 
@@ -155,6 +172,8 @@ public:
   bool good() const;
 
 private:
+  friend class ParallelReader;
+
   enum TokenType {
     tokenEndOfStream = 0,
     tokenObjectBegin,
@@ -188,6 +207,14 @@ private:
 
   typedef std::deque<ErrorInfo> Errors;
 
+  bool readDocument(const char* beginDoc,
+                    const char* endDoc,
+                    Value& root,
+                    bool collectComments);
+  bool readElement(const char* beginDoc,
+                   const char* beginElement,
+                   const char* endElement,
+                   Value& element);
   bool readToken(Token& token);
   void skipSpaces();
   bool match(Location pattern, int patternLength);
@@ -198,6 +225,7 @@ private:
   void readNumber();
   bool readValue();
   bool readObject(Token& token);
+  Value& resolveMember(const std::string& name);
   bool readArray(Token& token);
   bool decodeNumber(Token& token);
   bool decodeNumber(Token& token, Value& decoded);
@@ -226,6 +254,8 @@ private:
   std::string getLocationLineAndColumn(Location location) const;
   void addComment(Location begin, Location end, CommentPlacement placement);
   void skipCommentTokens(Token& token);
+  void recordOffsetStart(Location start);
+  void recordOffsetLimit(Location limit);
 
   typedef std::stack<Value*> Nodes;
   Nodes nodes_;
@@ -239,6 +269,8 @@ private:
   std::string commentsBefore_;
   Features features_;
   bool collectComments_;
+  bool collectOffsets_;
+  ValueArena* arena_;
 };  // Reader
 
 /** Interface for reading JSON from a char array.
@@ -267,6 +299,20 @@ public:
       char const* beginDoc, char const* endDoc,
       Value* root, std::string* errs) = 0;
 
+  /** \brief Read a <a HREF="http://www.json.org">JSON</a> document into a
+   * Document.
+   *
+   * Readers built with CharReaderBuilder::useArena_ take the whole tree from
+   * the document's arena.
+   * \param doc [out] Receives the tree; its previous tree is dropped first.
+   * \param errs [out] Formatted error messages (if not NULL)
+   * \return \c true if the document was successfully parsed, \c false if an
+   error occurred.
+   */
+  virtual bool parse(
+      char const* beginDoc, char const* endDoc,
+      Document* doc, std::string* errs) = 0;
+
   class Factory {
   public:
     /// \brief Allocate a CharReader via operator new().
@@ -292,6 +338,9 @@ class CharReaderBuilder : public CharReader::Factory {
 public:
   bool collectComments_;
   Features features_;
+  /// Take the trees read into a Document from its arena. Off by default.
+  /// \see Document
+  bool useArena_;
 
   CharReaderBuilder();
   virtual ~CharReaderBuilder();
@@ -308,6 +357,13 @@ bool parseFromStream(
     std::istream&,
     Value* root, std::string* errs);
 
+/** Same as above, into a Document.
+  */
+bool parseFromStream(
+    CharReader::Factory const&,
+    std::istream&,
+    Document* doc, std::string* errs);
+
 /** \brief Read from 'sin' into 'root'.
 
  Always keep comments from the input JSON.
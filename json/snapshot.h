@@ -0,0 +1,122 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_SNAPSHOT_H_INCLUDED
+#define CPPTL_JSON_SNAPSHOT_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string>
+
+namespace Json {
+
+class CompiledPath;
+
+/** \brief Immutable JSON tree whose subtrees are shared between versions.
+ *
+ * A Snapshot is a counted reference to a node that never changes once
+ * built. Copying one is O(1), and any number of threads may read the same
+ * tree at once. A new version is made with with(), which copies only the
+ * nodes on the changed path and shares every other subtree with the old
+ * version.
+ *
+ * Each node stores its structural hash, so comparing two snapshots that
+ * share most of their nodes is cheap.
+ *
+ * Each node owns copies of its member names and frees them with the node,
+ * so snapshots of documents with unbounded member names do not grow the
+ * process-wide Key pool. Reals are stored decoded, so that reads never
+ * write to a node.
+ *
+ * \code
+ * Json::Snapshot current(root);                  // deep copy, once
+ * Json::Snapshot next = current.with(pd, Json::Snapshot(Json::Value(31.5)));
+ * double ipd = next[kEyes][kLeft][kPupilDistance].asDouble();
+ * \endcode
+ *
+ * The reference count is atomic when JSON_HAS_THREADS is defined, so
+ * snapshots sharing nodes may be copied and destroyed on any thread. As with
+ * std::shared_ptr, one Snapshot object must still not be assigned on one
+ * thread while another thread reads or copies it.
+ */
+class JSON_API Snapshot {
+public:
+  /// A null snapshot. Allocates nothing.
+  Snapshot();
+  /// Deep copy of \a value.
+  explicit Snapshot(const Value& value);
+  /// Deep copy of \a value that reuses every subtree of \a previous equal to
+  /// the matching subtree of \a value.
+  Snapshot(const Value& value, const Snapshot& previous);
+  Snapshot(const Snapshot& other);
+  ~Snapshot();
+
+  Snapshot& operator=(Snapshot other);
+  void swap(Snapshot& other);
+
+  ValueType type() const;
+  bool isNull() const;
+  /// Number of elements or members; 0 for other types.
+  ArrayIndex size() const;
+
+  /// Return the member named \a key, or a null snapshot.
+  const Snapshot& operator[](const Key& key) const;
+  /// Return the element at \a index, or a null snapshot.
+  const Snapshot& operator[](ArrayIndex index) const;
+  /// Return the member named \a key, or NULL if there is none or this is not
+  /// an object.
+  const Snapshot* find(const Key& key) const;
+  /// Return the node at \a path, or NULL.
+  const Snapshot* find(const CompiledPath& path) const;
+  /// Name of the member at \a index of an object, valid while this
+  /// snapshot holds the node.
+  const char* memberName(ArrayIndex index) const;
+
+  /// Scalar content, converted as by the Value accessors. Containers and
+  /// null give the Value::null conversions.
+  const Value& scalar() const;
+  std::string asString() const;
+  Value::Int asInt() const;
+  Value::UInt asUInt() const;
+  double asDouble() const;
+  bool asBool() const;
+
+  /// Copy the tree back into a Value.
+  Value toValue() const;
+
+  /// Return a version in which the node at \a path is \a value. Missing
+  /// objects and arrays along the path are created as by CompiledPath::make().
+  /// Every subtree off the path is shared with this snapshot.
+  /// \pre path.isValid()
+  Snapshot with(const CompiledPath& path, const Snapshot& value) const;
+
+  /// Structural hash, computed when the node was built. Equal snapshots hash
+  /// equal; it is not the same number as Value::hash().
+  Value::LargestUInt hash() const;
+  /// \c true if both refer to the very same node.
+  bool shares(const Snapshot& other) const;
+
+  bool operator==(const Snapshot& other) const;
+  bool operator!=(const Snapshot& other) const;
+
+private:
+  struct Node;
+
+  explicit Snapshot(Node* node);
+
+  const Snapshot* findName(const char* name, size_t length) const;
+  static Node* build(const Value& value, const Snapshot* previous);
+  static Snapshot replace(const Snapshot& node,
+                          const CompiledPath& path,
+                          size_t step,
+                          const Snapshot& value);
+
+  Node* node_;
+};
+
+} // namespace Json
+
+#endif // CPPTL_JSON_SNAPSHOT_H_INCLUDED
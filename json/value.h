@@ -9,6 +9,8 @@
 #if !defined(JSON_IS_AMALGAMATION)
 #include "forwards.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cstddef>
+#include <new>
 #include <string>
 #include <vector>
 
@@ -84,6 +86,236 @@ private:
   const char* str_;
 };
 
+/** \brief Interned, pre-hashed member name for repeated lookups.
+ *
+ * Build a Key once and reuse it, typically as a static:
+ * \code
+ * static const Json::Key pupilDistance("pupilDistance");
+ * double pd = eye[pupilDistance].asDouble();
+ * \endcode
+ * The text is copied into a process-wide pool the first time it is seen, and
+ * every Key with the same text shares that copy. Two Keys are therefore
+ * equal exactly when their c_str() pointers are, and the pooled text is
+ * never freed. Members created through a Key reuse the pooled text instead
+ * of duplicating the name.
+ */
+class JSON_API Key {
+public:
+  /// Usage counters of the pool shared by all Keys.
+  struct PoolStatistics {
+    /// Names looked up in the pool, by Keys and by readers interning keys.
+    size_t lookups;
+    /// Lookups that found the name already pooled.
+    size_t hits;
+    /// Distinct names in the pool.
+    size_t names;
+    /// Bytes held by the pool, text and index.
+    size_t bytes;
+  };
+
+  explicit Key(const char* name);
+  explicit Key(const std::string& name);
+  Key(const char* name, size_t length);
+
+  /// Return a snapshot of the pool counters. hits / lookups is the hit rate.
+  static PoolStatistics poolStatistics();
+
+  const char* c_str() const { return cstr_; }
+  unsigned int length() const { return length_; }
+  /// 32-bit FNV-1a hash of the text.
+  unsigned int hash() const { return hash_; }
+
+  bool operator==(const Key& other) const { return cstr_ == other.cstr_; }
+  bool operator!=(const Key& other) const { return cstr_ != other.cstr_; }
+
+private:
+  void init(const char* name, unsigned int length);
+
+  const char* cstr_;
+  unsigned int length_;
+  unsigned int hash_;
+};
+
+/** \brief Counters kept by a MemoryCounter, a ValueArena or a Document.
+ */
+struct JSON_API MemoryStatistics {
+  MemoryStatistics();
+
+  /// Bytes held now.
+  size_t bytes;
+  /// Most bytes held at any one time.
+  size_t peakBytes;
+  /// Blocks handed out.
+  size_t allocations;
+  /// Blocks given back.
+  size_t releases;
+};
+
+/** \brief Where Values get the heap memory for their strings, member names,
+ * number tokens, comments and container nodes, and where Documents get their
+ * roots and arena chunks.
+ *
+ * The defaults call malloc() and free(). A block is always released through
+ * the hooks installed at the time, so hooks installed while Values exist must
+ * be able to free blocks from malloc(), and stay installed until the Values
+ * they served are gone. install() is not synchronized: call it before other
+ * threads use Values. Storage that lives until exit, such as the Key pool,
+ * does not go through the hooks.
+ */
+class JSON_API MemoryHooks {
+public:
+  virtual ~MemoryHooks();
+
+  /// Return \a size bytes aligned for any type, or NULL.
+  virtual void* allocate(size_t size);
+  /// Free \a block, of \a size bytes, returned by allocate().
+  virtual void release(void* block, size_t size);
+
+  /// Route every later allocation through \a hooks; NULL restores malloc()
+  /// and free(). Return the hooks replaced, or NULL.
+  static MemoryHooks* install(MemoryHooks* hooks);
+  /// The hooks installed, or NULL.
+  static MemoryHooks* installed();
+
+  /// Allocate through the installed hooks. Never returns NULL.
+  static void* allocateBlock(size_t size);
+  /// Release through the installed hooks.
+  static void releaseBlock(void* block, size_t size);
+};
+
+/** \brief MemoryHooks that count what goes through them.
+ *
+ * Install one around a parse or a write to see how many blocks and bytes it
+ * takes:
+ * \code
+ * Json::MemoryCounter counter;
+ * Json::MemoryHooks* previous = Json::MemoryHooks::install(&counter);
+ * reader.parse(text, root);
+ * Json::MemoryStatistics stats = counter.statistics();
+ * \endcode
+ * Blocks are passed on to \a next, or to malloc() and free(). Counting is
+ * atomic when JSON_HAS_THREADS is defined. Blocks allocated before the
+ * counter was installed and released while it is are counted as releases,
+ * but do not take bytes below zero.
+ */
+class JSON_API MemoryCounter : public MemoryHooks {
+public:
+  explicit MemoryCounter(MemoryHooks* next = 0);
+  ~MemoryCounter();
+
+  void* allocate(size_t size);
+  void release(void* block, size_t size);
+
+  MemoryStatistics statistics() const;
+  /// Zero the counters. The peak restarts from zero too.
+  void reset();
+
+private:
+  MemoryCounter(const MemoryCounter&);
+  void operator=(const MemoryCounter&);
+
+  struct Counters;
+  MemoryHooks* next_;
+  Counters* counters_;
+};
+
+/** \brief Bump-pointer storage shared by all the nodes of one document.
+ *
+ * Memory is handed out from a list of growing chunks and is never returned
+ * piecemeal: release() frees every chunk at once. Values built with an arena
+ * (see Value(ValueType, ValueArena*)) take their container nodes from it, so
+ * the arena must outlive them. Most code should not use this directly but
+ * parse into a Document instead.
+ */
+class JSON_API ValueArena {
+public:
+  ValueArena();
+  ~ValueArena();
+
+  /// Return \a size bytes aligned for any node stored in a Value.
+  void* allocate(size_t size);
+  /// Copy \a length bytes of \a text into the arena and zero-terminate them.
+  char* duplicate(const char* text, size_t length);
+  /// Free every chunk. All storage handed out so far becomes invalid.
+  void release();
+
+  /// Bytes handed out since the last release().
+  size_t used() const;
+  /// Bytes held in chunks since the last release().
+  size_t reserved() const;
+  /// Bytes held in chunks and blocks handed out since the last release().
+  /// The peak covers the whole life of the arena.
+  MemoryStatistics statistics() const;
+
+private:
+  ValueArena(const ValueArena&);
+  void operator=(const ValueArena&);
+
+  void* allocateFromNewChunk(size_t size);
+
+  struct Chunk;
+  Chunk* chunks_;
+  char* current_;
+  char* limit_;
+  size_t used_;
+  size_t reserved_;
+  size_t blocks_;
+  size_t peakReserved_;
+};
+
+/** \brief Allocator for the nodes of an arrayValue or objectValue.
+ *
+ * Without an arena it forwards to the installed MemoryHooks. With one, nodes come
+ * from the arena and deallocate() does nothing: they are reclaimed when the
+ * arena is released.
+ */
+template <typename T> class ValueAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U> struct rebind { typedef ValueAllocator<U> other; };
+
+  ValueAllocator(ValueArena* arena = 0) : arena_(arena) {}
+  template <typename U>
+  ValueAllocator(const ValueAllocator<U>& other) : arena_(other.arena()) {}
+
+  pointer allocate(size_type n, const void* = 0) {
+    size_t size = n * sizeof(T);
+    return static_cast<pointer>(arena_ ? arena_->allocate(size)
+                                       : MemoryHooks::allocateBlock(size));
+  }
+  void deallocate(pointer p, size_type n) {
+    if (!arena_)
+      MemoryHooks::releaseBlock(p, n * sizeof(T));
+  }
+  void construct(pointer p, const T& value) { new (p) T(value); }
+  void destroy(pointer p) { p->~T(); }
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+  size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+  /// The arena nodes are taken from, or NULL for the heap.
+  ValueArena* arena() const { return arena_; }
+
+private:
+  ValueArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ValueAllocator<T>& a, const ValueAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+template <typename T, typename U>
+bool operator!=(const ValueAllocator<T>& a, const ValueAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -115,6 +347,7 @@ private:
  */
 class JSON_API Value {
   friend class ValueIteratorBase;
+  friend class Reader;
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   friend class ValueInternalLink;
   friend class ValueInternalMap;
@@ -186,7 +419,11 @@ private:
 
 public:
 #ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
+  typedef std::map<CZString,
+                   Value,
+                   std::less<CZString>,
+                   ValueAllocator<std::pair<const CZString, Value> > >
+  ObjectValues;
 #else
   typedef CppTL::SmallMap<CZString, Value> ObjectValues;
 #endif // ifndef JSON_USE_CPPTL_SMALLMAP
@@ -210,6 +447,12 @@ Json::Value obj_value(Json::objectValue); // {}
 \endcode
   */
   Value(ValueType type = nullValue);
+  /** \brief Create an empty array or object whose nodes come from \a arena.
+
+   * The arena must outlive the Value; a null arena means the heap. Copies of
+   * such a Value are ordinary heap-backed Values. Other types ignore the arena.
+   */
+  Value(ValueType type, ValueArena* arena);
   Value(Int value);
   Value(UInt value);
 #if defined(JSON_HAS_INT64)
@@ -257,6 +500,41 @@ Json::Value obj_value(Json::objectValue); // {}
   bool operator!=(const Value& other) const;
   int compare(const Value& other) const;
 
+  /** \brief Structural hash of the payload: values that compare equal hash
+   * equal, so a.hash() != b.hash() proves a != b.
+   *
+   * Computed afresh on every call, in time linear in the size of the tree,
+   * so it always reflects the tree as it is. Safe to call from several
+   * threads on a tree none of them changes. The value is only stable within
+   * one process. A Snapshot keeps the hash of every node, for trees that
+   * are compared again and again.
+   */
+  LargestUInt hash() const;
+
+  /// Heap memory held by a subtree, as reported by memoryFootprint().
+  struct Footprint {
+    /// Values in the subtree, this one included.
+    size_t values;
+    /// Heap blocks the subtree owns.
+    size_t allocations;
+    /// Bytes in those blocks.
+    size_t bytes;
+    /// Part of bytes holding strings, member names, number tokens and
+    /// comments.
+    size_t textBytes;
+  };
+
+  /** \brief Report the heap memory this Value owns, directly or through its
+   * children: what destroying it would give back to the MemoryHooks.
+   *
+   * The Value itself is not counted, as its owner holds it. Nothing in a
+   * ValueArena is counted either (see Document::memoryStatistics()), nor
+   * pooled member names and StaticStrings, which are shared. Container nodes
+   * are sized as the red-black tree node of the common standard libraries:
+   * three links and a colour around the member.
+   */
+  Footprint memoryFootprint() const;
+
   const char* asCString() const;
   std::string asString() const;
 #ifdef JSON_USE_CPPTL
@@ -273,6 +551,8 @@ Json::Value obj_value(Json::objectValue); // {}
   float asFloat() const;
   double asDouble() const;
   bool asBool() const;
+  /// The source text of a real read with Features::lazyNumbers_, or NULL.
+  const char* numberToken() const;
 
   bool isNull() const;
   bool isBool() const;
@@ -371,6 +651,17 @@ Json::Value obj_value(Json::objectValue); // {}
    * \endcode
    */
   Value& operator[](const StaticString& key);
+  /// Access an object value by interned name, create a null member if it
+  /// does not exist. The new member shares the Key's pooled text.
+  Value& operator[](const Key& key);
+  /// Access an object value by interned name, returns null if there is no
+  /// member with that name.
+  const Value& operator[](const Key& key) const;
+  /// Return the member named key, or NULL if there is no such member or
+  /// this is not an object.
+  const Value* find(const Key& key) const;
+  /// Same as above, for a name that is not pooled.
+  const Value* find(const char* key) const;
 #ifdef JSON_USE_CPPTL
   /// Access an object value by name, create a null member if it does not exist.
   Value& operator[](const CppTL::ConstString& key);
@@ -451,14 +742,39 @@ Json::Value obj_value(Json::objectValue); // {}
   iterator end();
 
   // Accessors for the [start, limit) range of bytes within the JSON text from
-  // which this value was parsed, if any.
+  // which this value was parsed, if any. The Reader records them unless
+  // Features::collectOffsets_ is cleared or it reads into an arena Document.
   void setOffsetStart(size_t start);
   void setOffsetLimit(size_t limit);
   size_t getOffsetStart() const;
   size_t getOffsetLimit() const;
 
+  /// Usage counters of the side table holding comments and source offsets.
+  struct ExtraStatistics {
+    /// Entries out of the table: held by Values or cached by threads.
+    size_t entries;
+    /// Pages of entries currently allocated.
+    size_t pages;
+    /// Bytes held by those pages.
+    size_t bytes;
+    /// Times the table was locked to hand out or take back entries.
+    size_t locks;
+  };
+
+  /** \brief Return a snapshot of the side table counters.
+   *
+   * Each thread takes entries from the table and gives them back in
+   * batches, so locks grows far slower than the number of Values with
+   * comments or offsets built and destroyed.
+   */
+  static ExtraStatistics extraStatistics();
+
 private:
   void initBasic(ValueType type, bool allocated = false);
+  /// Make the payload a real kept as the token [begin, end). The previous
+  /// payload is overwritten, not released.
+  void setLazyReal(const char* begin, const char* end, ValueArena* arena);
+  double realPayload() const;
 
   Value& resolveReference(const char* key, bool isStatic);
 
@@ -475,15 +791,6 @@ private:
 #endif // # ifdef JSON_VALUE_USE_INTERNAL_MAP
 
 private:
-  struct CommentInfo {
-    CommentInfo();
-    ~CommentInfo();
-
-    void setComment(const char* text, size_t len);
-
-    char* comment_;
-  };
-
   // struct MemberNamesTransform
   //{
   //   typedef const char *result_type;
@@ -493,10 +800,13 @@ private:
   //   }
   //};
 
+  struct LazyReal;
+
   union ValueHolder {
     LargestInt int_;
     LargestUInt uint_;
     double real_;
+    LazyReal* lazyReal_;
     bool bool_;
     char* string_;
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
@@ -508,16 +818,60 @@ private:
   } value_;
   ValueType type_ : 8;
   unsigned int allocated_ : 1; // Notes: if declared as bool, bitfield is useless.
+  unsigned int lazy_ : 1;      // realValue held as lazyReal_
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   unsigned int itemIsUsed_ : 1; // used by the ValueInternalMap container.
   unsigned int memberNameIsStatic_ : 1;  // used by the ValueInternalMap container.
 #endif
-  CommentInfo* comments_;
+  // Comments and [start, limit) source offsets are rare, so they live in a
+  // side table. This is the index of this Value's entry, or 0 if it has none.
+  unsigned int extra_;
+};
+
+/** \brief A parsed JSON document that owns the storage of its tree.
+ *
+ * When a document is filled by a reader built with CharReaderBuilder::useArena_
+ * (or Reader::parse(const char*, const char*, Document&, bool)), every node,
+ * string and member name of the tree comes from the document's ValueArena.
+ * The tree is then read-only, and clearing or destroying the document drops
+ * it in one step instead of walking and freeing every node.
+ *
+ * Copying a Value out of root() yields an ordinary heap-backed Value that
+ * may outlive the document.
+ */
+class JSON_API Document {
+public:
+  Document();
+  ~Document();
+
+  /// The root of the tree, or null if nothing was parsed.
+  const Value& root() const;
+  /// Drop the tree.
+  void clear();
+  /// Return true if the current tree lives in the document's arena.
+  bool usesArena() const;
+  /// Bytes of arena storage held by the current tree.
+  size_t arenaSize() const;
+  /** \brief Memory held by the current tree: the arena's counters, or for a
+   * heap tree the root plus its memoryFootprint(). The peak covers every
+   * arena tree the document has held, and heap trees as of the calls to this
+   * function.
+   */
+  MemoryStatistics memoryStatistics() const;
+
+private:
+  friend class Reader;
+
+  Document(const Document&);
+  void operator=(const Document&);
+
+  /// Drop the current tree and return a new null root to parse into.
+  Value& resetRoot(bool useArena);
 
-  // [start, limit) byte offsets in the source JSON text from which this Value
-  // was extracted.
-  size_t start_;
-  size_t limit_;
+  ValueArena arena_;
+  Value* root_;
+  bool useArena_;
+  mutable size_t peakBytes_;
 };
 
 /** \brief Experimental and untested: represents an element of the "path" to
@@ -192,16 +192,38 @@ public:
 
   void omitEndingLineFeed();
 
+  /** \brief Write large arrays and objects on the threads of \a pool.
+   *
+   * The elements or members of each array or object that has at least
+   * \a minimumSize of them are split into chunks, which are written into
+   * separate buffers on the pool's threads and joined in order. Arrays and
+   * objects inside a chunk are written by the chunk's thread. The output is
+   * the same, byte for byte, as without a pool. Pass NULL to write on the
+   * calling thread only, as by default.
+   */
+  void useWorkerPool(WorkerPool* pool, ArrayIndex minimumSize = 1024);
+
 public: // overridden from Writer
   virtual std::string write(const Value& root);
 
 private:
+  struct ChunkJob;
+  static void writeChunk(void* context, size_t chunk);
+
   void writeValue(const Value& value);
+  void writeElements(const Value& value, ArrayIndex begin, ArrayIndex end);
+  void writeMembers(const Value& value,
+                    const Value::Members& members,
+                    size_t begin,
+                    size_t end);
+  bool writeInChunks(const Value& value, const Value::Members* members);
 
   std::string document_;
   bool yamlCompatiblityEnabled_;
   bool dropNullPlaceholders_;
   bool omitEndingLineFeed_;
+  WorkerPool* pool_;
+  ArrayIndex parallelSize_;
 };
 
 /** \brief Writes a Value in <a HREF="http://www.json.org">JSON</a> format in a
@@ -233,6 +255,17 @@ public:
   StyledWriter();
   virtual ~StyledWriter() {}
 
+  /** \brief Write large arrays and objects on the threads of \a pool.
+   *
+   * The elements or members of each array or object that has at least
+   * \a minimumSize of them are split into chunks, which are written into
+   * separate buffers on the pool's threads and joined in order. Arrays and
+   * objects inside a chunk are written by the chunk's thread. The output is
+   * the same, byte for byte, as without a pool. Pass NULL to write on the
+   * calling thread only, as by default.
+   */
+  void useWorkerPool(WorkerPool* pool, ArrayIndex minimumSize = 1024);
+
 public: // overridden from Writer
   /** \brief Serialize a Value in <a HREF="http://www.json.org">JSON</a> format.
    * \param root Value to serialize.
@@ -241,8 +274,17 @@ public: // overridden from Writer
   virtual std::string write(const Value& root);
 
 private:
+  struct ChunkJob;
+  static void writeChunk(void* context, size_t chunk);
+
   void writeValue(const Value& value);
   void writeArrayValue(const Value& value);
+  void writeElements(const Value& value, ArrayIndex begin, ArrayIndex end);
+  void writeMembers(const Value& value,
+                    const Value::Members& members,
+                    size_t begin,
+                    size_t end);
+  bool writeInChunks(const Value& value, const Value::Members* members);
   bool isMultineArray(const Value& value);
   void pushValue(const std::string& value);
   void writeIndent();
@@ -262,6 +304,8 @@ private:
   int rightMargin_;
   int indentSize_;
   bool addChildValues_;
+  WorkerPool* pool_;
+  ArrayIndex parallelSize_;
 };
 
 /** \brief Writes a Value in <a HREF="http://www.json.org">JSON</a> format in a
@@ -0,0 +1,413 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <json/parallel.h>
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <algorithm>
+#include <memory>
+#include <vector>
+#if defined(JSON_HAS_THREADS)
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace Json {
+
+// class WorkerPool
+// //////////////////////////////////////////////////////////////////
+
+struct WorkerPool::Shared {
+  unsigned int threads_;
+#if defined(JSON_HAS_THREADS)
+  void work();
+  void serve();
+
+  std::vector<std::thread> workers_;
+  std::mutex runMutex_; // held by the thread running a job
+  std::mutex mutex_;    // guards the members below, but next_ and failed_
+  std::condition_variable wake_;
+  std::condition_variable finished_;
+  unsigned long generation_; // bumped for each job
+  bool stopping_;
+  Task task_;
+  void* context_;
+  size_t count_;
+  unsigned int busy_; // workers that have not finished the job yet
+  std::exception_ptr error_;
+  std::atomic<size_t> next_;
+  std::atomic<bool> failed_;
+#endif
+};
+
+#if defined(JSON_HAS_THREADS)
+void WorkerPool::Shared::work() {
+  for (;;) {
+    size_t index = next_.fetch_add(1);
+    if (index >= count_ || failed_)
+      return;
+    try {
+      task_(context_, index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+      failed_ = true;
+    }
+  }
+}
+
+void WorkerPool::Shared::serve() {
+  unsigned long seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stopping_ && generation_ == seen)
+        wake_.wait(lock);
+      if (stopping_)
+        return;
+      seen = generation_;
+    }
+    work();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_ == 0)
+      finished_.notify_one();
+  }
+}
+#endif // if defined(JSON_HAS_THREADS)
+
+WorkerPool::WorkerPool(unsigned int threads) : shared_(new Shared) {
+#if defined(JSON_HAS_THREADS)
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  shared_->threads_ = threads;
+  shared_->generation_ = 0;
+  shared_->stopping_ = false;
+  shared_->task_ = 0;
+  shared_->context_ = 0;
+  shared_->count_ = 0;
+  shared_->busy_ = 0;
+  shared_->next_ = 0;
+  shared_->failed_ = false;
+  for (unsigned int worker = 1; worker < threads; ++worker)
+    shared_->workers_.push_back(std::thread(&Shared::serve, shared_));
+#else
+  (void)threads;
+  shared_->threads_ = 1;
+#endif
+}
+
+WorkerPool::~WorkerPool() {
+#if defined(JSON_HAS_THREADS)
+  {
+    std::lock_guard<std::mutex> lock(shared_->mutex_);
+    shared_->stopping_ = true;
+  }
+  shared_->wake_.notify_all();
+  for (size_t worker = 0; worker < shared_->workers_.size(); ++worker)
+    shared_->workers_[worker].join();
+#endif
+  delete shared_;
+}
+
+unsigned int WorkerPool::threads() const { return shared_->threads_; }
+
+void WorkerPool::run(size_t count, Task task, void* context) {
+#if defined(JSON_HAS_THREADS)
+  if (count > 1 && !shared_->workers_.empty()) {
+    Shared& shared = *shared_;
+    std::lock_guard<std::mutex> running(shared.runMutex_);
+    {
+      std::lock_guard<std::mutex> lock(shared.mutex_);
+      shared.task_ = task;
+      shared.context_ = context;
+      shared.count_ = count;
+      shared.busy_ = static_cast<unsigned int>(shared.workers_.size());
+      shared.error_ = std::exception_ptr();
+      shared.next_ = 0;
+      shared.failed_ = false;
+      ++shared.generation_;
+    }
+    shared.wake_.notify_all();
+    shared.work();
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(shared.mutex_);
+      while (shared.busy_)
+        shared.finished_.wait(lock);
+      std::swap(error, shared.error_);
+    }
+    if (error)
+      std::rethrow_exception(error);
+    return;
+  }
+#endif
+  for (size_t index = 0; index < count; ++index)
+    task(context, index);
+}
+
+// class ParallelReader
+// //////////////////////////////////////////////////////////////////
+
+static const size_t defaultMinimumSize = 256 * 1024;
+
+// Runs per thread. More than one evens out runs that take longer than
+// their size suggests.
+static const size_t runsPerThread = 4;
+
+/// One parse split into runs of elements, shared by the tasks.
+struct ParallelReader::ReadJob {
+  const Features* features_;
+  const char* beginDoc_;
+  const std::vector<const char*>* bounds_;
+  std::vector<size_t> runs_;  // first element of each run, then the count
+  std::vector<Value*> slots_; // the elements of the pre-sized array
+  std::vector<char> failed_;  // one flag per run
+};
+
+ParallelReader::ParallelReader(WorkerPool& pool)
+    : pool_(pool), features_(Features::all()),
+      minimumSize_(defaultMinimumSize), runCount_(0), good_(true),
+      reader_(features_) {}
+
+ParallelReader::ParallelReader(WorkerPool& pool, const Features& features)
+    : pool_(pool), features_(features), minimumSize_(defaultMinimumSize),
+      runCount_(0), good_(true), reader_(features) {}
+
+size_t ParallelReader::minimumSize() const { return minimumSize_; }
+
+void ParallelReader::setMinimumSize(size_t bytes) { minimumSize_ = bytes; }
+
+size_t ParallelReader::lastRunCount() const { return runCount_; }
+
+void ParallelReader::readRun(void* context, size_t run) {
+  ReadJob& job = *static_cast<ReadJob*>(context);
+  const std::vector<const char*>& bounds = *job.bounds_;
+  Reader reader(*job.features_);
+  for (size_t element = job.runs_[run]; element < job.runs_[run + 1];
+       ++element) {
+    if (!reader.readElement(job.beginDoc_,
+                            bounds[element] + 1,
+                            bounds[element + 1],
+                            *job.slots_[element])) {
+      job.failed_[run] = 1;
+      return;
+    }
+  }
+}
+
+bool ParallelReader::parse(const char* beginDoc,
+                           const char* endDoc,
+                           Value& root) {
+  runCount_ = 0;
+  if (size_t(endDoc - beginDoc) < minimumSize_ || pool_.threads() < 2 ||
+      features_.allowDroppedNullPlaceholders_ ||
+      !scanRootArray(beginDoc, endDoc)) {
+    good_ = reader_.parse(beginDoc, endDoc, root, false);
+    return good_;
+  }
+
+  size_t elements = bounds_.size() - 1;
+  size_t runs = std::min(elements, size_t(pool_.threads()) * runsPerThread);
+  size_t total = size_t(bounds_.back() - bounds_.front());
+  ReadJob job;
+  job.features_ = &features_;
+  job.beginDoc_ = beginDoc;
+  job.bounds_ = &bounds_;
+  job.runs_.push_back(0);
+  for (size_t element = 1; element < elements; ++element) {
+    size_t offset = size_t(bounds_[element] - bounds_.front());
+    if (offset * runs >= total * job.runs_.size())
+      job.runs_.push_back(element);
+  }
+  job.runs_.push_back(elements);
+  runCount_ = job.runs_.size() - 1;
+  job.failed_.resize(runCount_);
+
+  // resize() would only add the last element; the others must exist too
+  // before the runs fill them in.
+  Value array(arrayValue);
+  job.slots_.reserve(elements);
+  for (size_t element = 0; element < elements; ++element)
+    job.slots_.push_back(&array.append(Value()));
+  pool_.run(runCount_, &ParallelReader::readRun, &job);
+
+  if (std::find(job.failed_.begin(), job.failed_.end(), 1) !=
+      job.failed_.end()) {
+    good_ = reader_.parse(beginDoc, endDoc, root, false);
+    return good_;
+  }
+  root.swapPayload(array);
+  if (features_.collectOffsets_) {
+    root.setOffsetStart(size_t(bounds_.front() - beginDoc));
+    root.setOffsetLimit(size_t(bounds_.back() + 1 - beginDoc));
+  }
+  good_ = true;
+  return true;
+}
+
+/// Skip a comment starting at \a current, which points at '/'. Return the
+/// position after it, or NULL if there is no complete comment there.
+static const char* skipComment(const char* current, const char* end) {
+  if (end - current < 2)
+    return 0;
+  if (current[1] == '*') {
+    for (current += 2; end - current >= 2; ++current) {
+      if (current[0] == '*' && current[1] == '/')
+        return current + 2;
+    }
+    return 0;
+  }
+  if (current[1] == '/') {
+    for (current += 2; current != end; ++current) {
+      if (*current == '\n' || *current == '\r')
+        return current;
+    }
+    return end;
+  }
+  return 0;
+}
+
+/** Find the '[' of the root array, the ',' between its elements and its
+ * ']', without decoding anything. Strings and comments are skipped, and
+ * brackets and braces counted alike; anything the Reader would reject inside
+ * an element is left for it to find. Return false if the root is not an
+ * array of at least two elements, or the brackets are not balanced.
+ */
+bool ParallelReader::scanRootArray(const char* beginDoc, const char* endDoc) {
+  bounds_.clear();
+  const char* current = beginDoc;
+  while (current != endDoc) {
+    char c = *current;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      ++current;
+    } else if (c == '/' && features_.allowComments_) {
+      current = skipComment(current, endDoc);
+      if (!current)
+        return false;
+    } else {
+      break;
+    }
+  }
+  if (current == endDoc || *current != '[')
+    return false;
+  bounds_.push_back(current++);
+  int depth = 1;
+  while (current != endDoc) {
+    switch (*current) {
+    case '"':
+      for (++current; current != endDoc && *current != '"'; ++current) {
+        if (*current == '\\' && ++current == endDoc)
+          return false;
+      }
+      if (current == endDoc)
+        return false;
+      break;
+    case '/':
+      if (features_.allowComments_) {
+        const char* after = skipComment(current, endDoc);
+        if (after) {
+          current = after;
+          continue;
+        }
+      }
+      break;
+    case '[':
+    case '{':
+      ++depth;
+      break;
+    case ']':
+    case '}':
+      if (--depth == 0) {
+        bounds_.push_back(current);
+        return *current == ']' && bounds_.size() > 2;
+      }
+      break;
+    case ',':
+      if (depth == 1)
+        bounds_.push_back(current);
+      break;
+    case 0:
+      // The Reader stops there.
+      return false;
+    }
+    ++current;
+  }
+  return false;
+}
+
+std::string ParallelReader::getFormattedErrorMessages() const {
+  return good_ ? std::string() : reader_.getFormattedErrorMessages();
+}
+
+std::vector<Reader::StructuredError>
+ParallelReader::getStructuredErrors() const {
+  return good_ ? std::vector<Reader::StructuredError>()
+               : reader_.getStructuredErrors();
+}
+
+// parseMany()
+// //////////////////////////////////////////////////////////////////
+
+#if __cplusplus >= 201103L
+typedef std::unique_ptr<CharReader> CharReaderPtr;
+#else
+typedef std::auto_ptr<CharReader>   CharReaderPtr;
+#endif
+
+// Batches per thread. Documents vary in size, so several batches per thread
+// keep the threads busy until the end.
+static const size_t batchesPerThread = 8;
+
+/// One call to parseMany(), shared by the tasks.
+struct ManyJob {
+  const CharReaderBuilder* builder_;
+  const DocumentText* texts_;
+  size_t count_;
+  size_t batches_;
+  Document* documents_;
+  std::string* errors_;
+  std::vector<size_t> failed_; // per batch
+};
+
+static void readBatch(void* context, size_t batch) {
+  ManyJob& job = *static_cast<ManyJob*>(context);
+  size_t begin = size_t(Value::LargestUInt(job.count_) * batch / job.batches_);
+  size_t end =
+      size_t(Value::LargestUInt(job.count_) * (batch + 1) / job.batches_);
+  CharReaderPtr const reader(job.builder_->newCharReader());
+  for (size_t index = begin; index < end; ++index) {
+    const DocumentText& text = job.texts_[index];
+    std::string* errors = job.errors_ ? &job.errors_[index] : 0;
+    if (!reader->parse(text.begin_, text.end_, &job.documents_[index], errors))
+      ++job.failed_[batch];
+  }
+}
+
+size_t parseMany(WorkerPool& pool,
+                 const CharReaderBuilder& builder,
+                 const DocumentText* texts,
+                 size_t count,
+                 Document* documents,
+                 std::string* errors) {
+  ManyJob job;
+  job.builder_ = &builder;
+  job.texts_ = texts;
+  job.count_ = count;
+  job.batches_ = std::min(count, size_t(pool.threads()) * batchesPerThread);
+  job.documents_ = documents;
+  job.errors_ = errors;
+  job.failed_.resize(job.batches_);
+  pool.run(job.batches_, &readBatch, &job);
+  size_t failed = 0;
+  for (size_t batch = 0; batch < job.batches_; ++batch)
+    failed += job.failed_[batch];
+  return failed;
+}
+
+} // namespace Json
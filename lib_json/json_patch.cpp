@@ -0,0 +1,440 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <json/patch.h>
+#include <json/pointer.h>
+#include "json_tool.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <sstream>
+#include <string.h>
+
+namespace Json {
+
+static const Key kOp("op");
+static const Key kPath("path");
+static const Key kFrom("from");
+static const Key kValue("value");
+
+// makePatch
+// //////////////////////////////////////////////////////////////////
+
+static void appendPointerName(std::string& path, const char* name) {
+  path += '/';
+  for (; *name; ++name) {
+    if (*name == '~')
+      path += "~0";
+    else if (*name == '/')
+      path += "~1";
+    else
+      path += *name;
+  }
+}
+
+static void appendPointerIndex(std::string& path, ArrayIndex index) {
+  UIntToStringBuffer buffer;
+  char* current = buffer + sizeof(buffer);
+  uintToString(index, current);
+  path += '/';
+  path += current;
+}
+
+static void addOperation(Value& patch,
+                         const char* op,
+                         const std::string& path,
+                         const Value* value) {
+  Value& operation = patch.append(Value(objectValue));
+  operation[kOp] = StaticString(op);
+  operation[kPath] = path;
+  if (value)
+    operation[kValue] = *value;
+}
+
+static void
+diffValues(const Value& from, const Value& to, std::string& path, Value& patch);
+
+static void diffObjects(const Value& from,
+                        const Value& to,
+                        std::string& path,
+                        Value& patch) {
+  // Members are stored sorted by name, so one pass over both finds the
+  // removed, added and common ones.
+  const size_t length = path.size();
+  Value::const_iterator itFrom = from.begin();
+  Value::const_iterator itTo = to.begin();
+  while (itFrom != from.end() || itTo != to.end()) {
+    int order;
+    if (itFrom == from.end())
+      order = 1;
+    else if (itTo == to.end())
+      order = -1;
+    else
+      order = strcmp(itFrom.memberName(), itTo.memberName());
+    if (order < 0) {
+      appendPointerName(path, itFrom.memberName());
+      addOperation(patch, "remove", path, 0);
+      ++itFrom;
+    } else if (order > 0) {
+      appendPointerName(path, itTo.memberName());
+      addOperation(patch, "add", path, &*itTo);
+      ++itTo;
+    } else {
+      appendPointerName(path, itTo.memberName());
+      diffValues(*itFrom, *itTo, path, patch);
+      ++itFrom;
+      ++itTo;
+    }
+    path.resize(length);
+  }
+}
+
+static void diffArrays(const Value& from,
+                       const Value& to,
+                       std::string& path,
+                       Value& patch) {
+  const size_t length = path.size();
+  const ArrayIndex fromSize = from.size();
+  const ArrayIndex toSize = to.size();
+  ArrayIndex prefix = 0;
+  while (prefix < fromSize && prefix < toSize && from[prefix] == to[prefix])
+    ++prefix;
+  ArrayIndex suffix = 0;
+  while (suffix < fromSize - prefix && suffix < toSize - prefix &&
+         from[fromSize - 1 - suffix] == to[toSize - 1 - suffix])
+    ++suffix;
+
+  const ArrayIndex fromMiddle = fromSize - prefix - suffix;
+  const ArrayIndex toMiddle = toSize - prefix - suffix;
+  const ArrayIndex common = fromMiddle < toMiddle ? fromMiddle : toMiddle;
+  for (ArrayIndex index = prefix; index < prefix + common; ++index) {
+    appendPointerIndex(path, index);
+    diffValues(from[index], to[index], path, patch);
+    path.resize(length);
+  }
+  for (ArrayIndex index = prefix + common; index < prefix + toMiddle;
+       ++index) {
+    appendPointerIndex(path, index);
+    addOperation(patch, "add", path, &to[index]);
+    path.resize(length);
+  }
+  // Highest index first, so the indices still to remove do not move.
+  for (ArrayIndex index = prefix + fromMiddle; index > prefix + common;
+       --index) {
+    appendPointerIndex(path, index - 1);
+    addOperation(patch, "remove", path, 0);
+    path.resize(length);
+  }
+}
+
+static void diffValues(const Value& from,
+                       const Value& to,
+                       std::string& path,
+                       Value& patch) {
+  if (from.type() == to.type() && from.type() == objectValue)
+    diffObjects(from, to, path, patch);
+  else if (from.type() == to.type() && from.type() == arrayValue)
+    diffArrays(from, to, path, patch);
+  else if (from != to)
+    addOperation(patch, "replace", path, &to);
+}
+
+Value makePatch(const Value& from, const Value& to) {
+  Value patch(arrayValue);
+  std::string path;
+  diffValues(from, to, path, patch);
+  return patch;
+}
+
+// applyPatch
+// //////////////////////////////////////////////////////////////////
+
+/** Split \a pointer into the pointer to its parent and its last token,
+ * unescaped. \a pointer must be a valid, non-empty JSON Pointer.
+ */
+static void splitPointer(const std::string& pointer,
+                         std::string& parent,
+                         std::string& token) {
+  // '/' inside a token is escaped, so the last one ends the parent.
+  size_t slash = pointer.rfind('/');
+  parent.assign(pointer, 0, slash);
+  token.clear();
+  for (size_t current = slash + 1; current < pointer.size(); ++current) {
+    char c = pointer[current];
+    if (c == '~')
+      c = pointer[++current] == '0' ? '~' : '/';
+    token += c;
+  }
+}
+
+static void insertElement(Value& array, ArrayIndex index, const Value& value) {
+  ArrayIndex size = array.size();
+  array.resize(size + 1);
+  for (ArrayIndex current = size; current > index; --current)
+    array[current].swap(array[current - 1]);
+  array[index] = value;
+}
+
+static void eraseElement(Value& array, ArrayIndex index, Value& removed) {
+  ArrayIndex size = array.size();
+  for (ArrayIndex current = index; current + 1 < size; ++current)
+    array[current].swap(array[current + 1]);
+  removed.swap(array[size - 1]);
+  array.resize(size - 1);
+}
+
+/** Find the container \a pointer points into, and where in it.
+ */
+static bool resolveParent(Value& root,
+                          const std::string& pointer,
+                          Value*& parent,
+                          std::string& token,
+                          std::string& error) {
+  CompiledPath path(pointer);
+  if (!path.isValid()) {
+    error = path.error();
+    return false;
+  }
+  std::string parentPointer;
+  splitPointer(pointer, parentPointer, token);
+  parent = CompiledPath(parentPointer).resolve(root);
+  if (!parent || !(parent->isObject() || parent->isArray())) {
+    error = "no object or array at '" + parentPointer + "'";
+    return false;
+  }
+  return true;
+}
+
+static bool addValue(Value& root,
+                     const std::string& pointer,
+                     const Value& value,
+                     std::string& error) {
+  if (pointer.empty()) {
+    root = value;
+    return true;
+  }
+  Value* parent;
+  std::string token;
+  if (!resolveParent(root, pointer, parent, token, error))
+    return false;
+  if (parent->isObject()) {
+    (*parent)[token] = value;
+    return true;
+  }
+  ArrayIndex index = parent->size();
+  if (token != "-" &&
+      (!decodeArrayIndex(token, index) || index > parent->size())) {
+    error = "bad array index in '" + pointer + "'";
+    return false;
+  }
+  insertElement(*parent, index, value);
+  return true;
+}
+
+static bool removeValue(Value& root,
+                        const std::string& pointer,
+                        Value& removed,
+                        std::string& error) {
+  if (pointer.empty()) {
+    removed.swap(root);
+    return true;
+  }
+  Value* parent;
+  std::string token;
+  if (!resolveParent(root, pointer, parent, token, error))
+    return false;
+  if (parent->isObject()) {
+    if (parent->removeMember(token.c_str(), &removed))
+      return true;
+  } else {
+    ArrayIndex index;
+    if (decodeArrayIndex(token, index) && index < parent->size()) {
+      eraseElement(*parent, index, removed);
+      return true;
+    }
+  }
+  error = "nothing to remove at '" + pointer + "'";
+  return false;
+}
+
+static bool getMember(const Value& operation,
+                      const Key& name,
+                      const Value*& member,
+                      std::string& error) {
+  member = operation.find(name);
+  if (!member) {
+    error = std::string("missing '") + name.c_str() + "'";
+    return false;
+  }
+  return true;
+}
+
+static bool getPointer(const Value& operation,
+                       const Key& name,
+                       std::string& pointer,
+                       std::string& error) {
+  const Value* member;
+  if (!getMember(operation, name, member, error))
+    return false;
+  if (!member->isString()) {
+    error = std::string("'") + name.c_str() + "' is not a string";
+    return false;
+  }
+  pointer = member->asString();
+  return true;
+}
+
+static bool
+applyOperation(Value& root, const Value& operation, std::string& error) {
+  std::string op, path;
+  if (!operation.isObject()) {
+    error = "not an object";
+    return false;
+  }
+  if (!getPointer(operation, kOp, op, error) ||
+      !getPointer(operation, kPath, path, error))
+    return false;
+
+  const Value* value;
+  std::string from;
+  if (op == "add") {
+    return getMember(operation, kValue, value, error) &&
+           addValue(root, path, *value, error);
+  } else if (op == "remove") {
+    Value removed;
+    return removeValue(root, path, removed, error);
+  } else if (op == "replace") {
+    if (!getMember(operation, kValue, value, error))
+      return false;
+    Value* target = CompiledPath(path).resolve(root);
+    if (!target) {
+      error = "nothing to replace at '" + path + "'";
+      return false;
+    }
+    *target = *value;
+    return true;
+  } else if (op == "move") {
+    if (!getPointer(operation, kFrom, from, error))
+      return false;
+    if (from == path)
+      return true;
+    if (path.compare(0, from.size() + 1, from + "/") == 0) {
+      error = "cannot move '" + from + "' into itself";
+      return false;
+    }
+    Value moved;
+    return removeValue(root, from, moved, error) &&
+           addValue(root, path, moved, error);
+  } else if (op == "copy") {
+    if (!getPointer(operation, kFrom, from, error))
+      return false;
+    const Value* source = CompiledPath(from).resolve(
+        static_cast<const Value&>(root));
+    if (!source) {
+      error = "nothing to copy at '" + from + "'";
+      return false;
+    }
+    // Copy first: adding may move or overwrite the source.
+    Value copy(*source);
+    return addValue(root, path, copy, error);
+  } else if (op == "test") {
+    if (!getMember(operation, kValue, value, error))
+      return false;
+    const Value* target =
+        CompiledPath(path).resolve(static_cast<const Value&>(root));
+    if (!target || *target != *value) {
+      error = "test failed at '" + path + "'";
+      return false;
+    }
+    return true;
+  }
+  error = "unknown op '" + op + "'";
+  return false;
+}
+
+bool applyPatch(Value& root, const Value& patch, std::string* errs) {
+  std::string error;
+  if (!patch.isArray()) {
+    error = "a JSON Patch must be an array";
+  } else {
+    for (ArrayIndex index = 0; index < patch.size(); ++index) {
+      if (applyOperation(root, patch[index], error))
+        continue;
+      std::ostringstream oss;
+      oss << "operation " << index << ": " << error;
+      error = oss.str();
+      break;
+    }
+  }
+  if (errs)
+    *errs = error;
+  return error.empty();
+}
+
+// makeMergePatch, applyMergePatch
+// //////////////////////////////////////////////////////////////////
+
+/** Set \a patch to the merge patch from \a from to \a to. Built in place
+ * rather than returned, so that no level copies the levels below it.
+ */
+static void
+makeMergePatch(const Value& from, const Value& to, Value& patch) {
+  if (!from.isObject() || !to.isObject()) {
+    patch = to;
+    return;
+  }
+  patch = Value(objectValue);
+  Value::const_iterator itFrom = from.begin();
+  Value::const_iterator itTo = to.begin();
+  while (itFrom != from.end() || itTo != to.end()) {
+    int order;
+    if (itFrom == from.end())
+      order = 1;
+    else if (itTo == to.end())
+      order = -1;
+    else
+      order = strcmp(itFrom.memberName(), itTo.memberName());
+    if (order < 0) {
+      patch[itFrom.memberName()] = Value();
+      ++itFrom;
+    } else if (order > 0) {
+      patch[itTo.memberName()] = *itTo;
+      ++itTo;
+    } else {
+      if (itFrom->isObject() && itTo->isObject()) {
+        Value& member = patch[itTo.memberName()];
+        makeMergePatch(*itFrom, *itTo, member);
+        if (member.empty())
+          patch.removeMember(itTo.memberName());
+      } else if (*itFrom != *itTo) {
+        patch[itTo.memberName()] = *itTo;
+      }
+      ++itFrom;
+      ++itTo;
+    }
+  }
+}
+
+Value makeMergePatch(const Value& from, const Value& to) {
+  Value patch;
+  makeMergePatch(from, to, patch);
+  return patch;
+}
+
+void applyMergePatch(Value& root, const Value& patch) {
+  if (!patch.isObject()) {
+    root = patch;
+    return;
+  }
+  if (!root.isObject())
+    root = Value(objectValue);
+  for (Value::const_iterator it = patch.begin(); it != patch.end(); ++it) {
+    if (it->isNull())
+      root.removeMember(it.memberName());
+    else
+      applyMergePatch(root[it.memberName()], *it);
+  }
+}
+
+} // namespace Json
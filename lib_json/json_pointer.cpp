@@ -0,0 +1,253 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <json/assertions.h>
+#include <json/pointer.h>
+#include "json_tool.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <sstream>
+#include <utility>
+
+namespace Json {
+
+// class CompiledPath
+// //////////////////////////////////////////////////////////////////
+
+CompiledPath::Step::Step(const std::string& name, bool poolName)
+    : name_(name), pooled_(poolName ? Key(name).c_str() : 0), index_(0),
+      isName_(false), isIndex_(false), isAppend_(false) {}
+
+CompiledPath::CompiledPath() : poolNames_(false) {}
+
+CompiledPath::CompiledPath(const std::string& path, bool poolNames)
+    : text_(path), poolNames_(poolNames) {
+  if (text_.empty() || text_[0] == '/')
+    compilePointer();
+  else
+    compileDotted();
+}
+
+bool CompiledPath::isValid() const { return error_.empty(); }
+
+const std::string& CompiledPath::error() const { return error_; }
+
+const std::string& CompiledPath::text() const { return text_; }
+
+void CompiledPath::compilePointer() {
+  size_t current = 0;
+  while (current != text_.size()) {
+    ++current; // skip '/'
+    std::string token;
+    while (current != text_.size() && text_[current] != '/') {
+      char c = text_[current++];
+      if (c == '~') {
+        char escape = current != text_.size() ? text_[current++] : '\0';
+        if (escape == '0')
+          c = '~';
+        else if (escape == '1')
+          c = '/';
+        else
+          return invalidPath("'~' must be followed by '0' or '1'", current - 1);
+      }
+      token += c;
+    }
+    addStep(token, true, true);
+  }
+}
+
+void CompiledPath::compileDotted() {
+  size_t current = 0;
+  while (current != text_.size()) {
+    char c = text_[current];
+    if (c == '[') {
+      size_t begin = ++current;
+      while (current != text_.size() && text_[current] >= '0' &&
+             text_[current] <= '9')
+        ++current;
+      if (current == text_.size() || text_[current] != ']')
+        return invalidPath("expected digits and ']' after '['", current);
+      ArrayIndex index;
+      std::string digits(text_, begin, current - begin);
+      if (digits.size() > 1 && digits[0] == '0')
+        digits.erase(0, digits.find_first_not_of('0'));
+      if (digits.empty())
+        digits = "0";
+      if (!decodeArrayIndex(digits, index))
+        return invalidPath("array index out of range", begin);
+      addStep(digits, false, true);
+      ++current;
+    } else if (c == '%') {
+      return invalidPath("'%' placeholders are not supported", current);
+    } else if (c == '.') {
+      ++current;
+    } else {
+      size_t begin = current;
+      while (current != text_.size() && text_[current] != '[' &&
+             text_[current] != '.')
+        ++current;
+      addStep(text_.substr(begin, current - begin), true, false);
+    }
+  }
+}
+
+void CompiledPath::addStep(const std::string& token, bool isName, bool isIndex) {
+  // Only member names are pooled: digits and "-" of a pointer may name
+  // either, "[n]" of a dotted path only an element.
+  Step step(token, poolNames_ && isName);
+  step.isName_ = isName;
+  step.isIndex_ = isIndex && decodeArrayIndex(token, step.index_);
+  step.isAppend_ = isName && isIndex && token == "-";
+  steps_.push_back(step);
+}
+
+void CompiledPath::invalidPath(const std::string& message, size_t location) {
+  std::ostringstream oss;
+  oss << "Invalid path '" << text_ << "' at offset " << location << ": "
+      << message;
+  error_ = oss.str();
+  steps_.clear();
+}
+
+const Value* CompiledPath::resolveStep(const Value& node, const Step& step) {
+  switch (node.type()) {
+  case objectValue:
+    return step.isName_ ? node.find(step.pooled_ ? step.pooled_
+                                                 : step.name_.c_str())
+                        : 0;
+  case arrayValue:
+    return step.isIndex_ && step.index_ < node.size() ? &node[step.index_] : 0;
+  default:
+    return 0;
+  }
+}
+
+const Value* CompiledPath::resolve(const Value& root) const {
+  if (!isValid())
+    return 0;
+  const Value* node = &root;
+  for (Steps::const_iterator it = steps_.begin(); node && it != steps_.end();
+       ++it)
+    node = resolveStep(*node, *it);
+  return node;
+}
+
+Value* CompiledPath::resolve(Value& root) const {
+  return const_cast<Value*>(resolve(static_cast<const Value&>(root)));
+}
+
+Value CompiledPath::resolve(const Value& root, const Value& defaultValue) const {
+  const Value* node = resolve(root);
+  return node ? *node : defaultValue;
+}
+
+Value& CompiledPath::make(Value& root) const {
+  JSON_ASSERT_MESSAGE(isValid(), error_);
+  Value* node = &root;
+  for (Steps::const_iterator it = steps_.begin(); it != steps_.end(); ++it) {
+    const Step& step = *it;
+    bool asArray = node->isArray() || (node->isNull() && !step.isName_);
+    if (asArray && step.isAppend_) {
+      node = &(*node)[node->size()];
+    } else if (asArray) {
+      JSON_ASSERT_MESSAGE(step.isIndex_,
+                          "in Json::CompiledPath::make(): "
+                          "array elements need a numeric step");
+      node = &(*node)[step.index_];
+    } else if (step.pooled_) {
+      // Pooled text is never freed, so the member can point at it.
+      node = &(*node)[StaticString(step.pooled_)];
+    } else {
+      node = &(*node)[step.name_];
+    }
+  }
+  return *node;
+}
+
+// class CompiledPathSet
+// //////////////////////////////////////////////////////////////////
+
+CompiledPathSet::Node::Node(const CompiledPath::Step& step) : step_(step) {}
+
+CompiledPathSet::CompiledPathSet() : count_(0) {}
+
+bool CompiledPathSet::sameStep(const CompiledPath::Step& a,
+                               const CompiledPath::Step& b) {
+  return a.name_ == b.name_ && a.index_ == b.index_ &&
+         a.isName_ == b.isName_ && a.isIndex_ == b.isIndex_ &&
+         a.isAppend_ == b.isAppend_;
+}
+
+size_t CompiledPathSet::add(const CompiledPath& path) {
+  JSON_ASSERT_MESSAGE(path.isValid(), path.error());
+  size_t index = count_++;
+  if (path.steps_.empty()) {
+    rootPaths_.push_back(index);
+    return index;
+  }
+  std::vector<size_t>* siblings = &roots_;
+  size_t node = 0;
+  for (CompiledPath::Steps::const_iterator it = path.steps_.begin();
+       it != path.steps_.end();
+       ++it) {
+    std::vector<size_t>::const_iterator found = siblings->begin();
+    while (found != siblings->end() && !sameStep(nodes_[*found].step_, *it))
+      ++found;
+    if (found != siblings->end()) {
+      node = *found;
+    } else {
+      node = nodes_.size();
+      siblings->push_back(node);
+      // Invalidates siblings, which is taken again below.
+      nodes_.push_back(Node(*it));
+    }
+    siblings = &nodes_[node].children_;
+  }
+  nodes_[node].paths_.push_back(index);
+  return index;
+}
+
+size_t CompiledPathSet::add(const std::string& path) {
+  return add(CompiledPath(path));
+}
+
+size_t CompiledPathSet::size() const { return count_; }
+
+void CompiledPathSet::resolve(const Value& root,
+                              std::vector<const Value*>& nodes) const {
+  nodes.assign(count_, 0);
+  for (std::vector<size_t>::const_iterator it = rootPaths_.begin();
+       it != rootPaths_.end();
+       ++it)
+    nodes[*it] = &root;
+
+  // Depth-first over the prefix tree, each entry holding a node and the
+  // Value its step applies to.
+  typedef std::pair<size_t, const Value*> Pending;
+  std::vector<Pending> pending;
+  for (std::vector<size_t>::const_reverse_iterator it = roots_.rbegin();
+       it != roots_.rend();
+       ++it)
+    pending.push_back(Pending(*it, &root));
+  while (!pending.empty()) {
+    const Node& node = nodes_[pending.back().first];
+    const Value* value =
+        CompiledPath::resolveStep(*pending.back().second, node.step_);
+    pending.pop_back();
+    if (!value)
+      continue; // every path below stays NULL
+    for (std::vector<size_t>::const_iterator it = node.paths_.begin();
+         it != node.paths_.end();
+         ++it)
+      nodes[*it] = value;
+    for (std::vector<size_t>::const_reverse_iterator it =
+             node.children_.rbegin();
+         it != node.children_.rend();
+         ++it)
+      pending.push_back(Pending(*it, value));
+  }
+}
+
+} // namespace Json
@@ -39,7 +39,8 @@ typedef std::auto_ptr<CharReader>   CharReaderPtr;
 
 Features::Features()
     : allowComments_(true), strictRoot_(false),
-      allowDroppedNullPlaceholders_(false), allowNumericKeys_(false) {}
+      allowDroppedNullPlaceholders_(false), allowNumericKeys_(false),
+      collectOffsets_(true), internKeys_(false), lazyNumbers_(false) {}
 
 Features Features::all() { return Features(); }
 
@@ -62,18 +63,53 @@ static bool containsNewLine(Reader::Location begin, Reader::Location end) {
   return false;
 }
 
+static bool isDigit(Reader::Char c) { return c >= '0' && c <= '9'; }
+
+/// Whether [begin, end) is a number as RFC 8259 writes them:
+/// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isStrictNumber(Reader::Location begin, Reader::Location end) {
+  Reader::Location current = begin;
+  if (current != end && *current == '-')
+    ++current;
+  if (current == end || !isDigit(*current))
+    return false;
+  if (*current++ == '0') {
+    if (current != end && isDigit(*current))
+      return false;
+  } else {
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  if (current != end && *current == '.') {
+    if (++current == end || !isDigit(*current))
+      return false;
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  if (current != end && (*current == 'e' || *current == 'E')) {
+    ++current;
+    if (current != end && (*current == '+' || *current == '-'))
+      ++current;
+    if (current == end || !isDigit(*current))
+      return false;
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  return current == end;
+}
+
 // Class Reader
 // //////////////////////////////////////////////////////////////////
 
 Reader::Reader()
     : errors_(), document_(), begin_(), end_(), current_(), lastValueEnd_(),
       lastValue_(), commentsBefore_(), features_(Features::all()),
-      collectComments_() {}
+      collectComments_(), collectOffsets_(), arena_() {}
 
 Reader::Reader(const Features& features)
     : errors_(), document_(), begin_(), end_(), current_(), lastValueEnd_(),
-      lastValue_(), commentsBefore_(), features_(features), collectComments_() {
-}
+      lastValue_(), commentsBefore_(), features_(features), collectComments_(),
+      collectOffsets_(), arena_() {}
 
 bool
 Reader::parse(const std::string& document, Value& root, bool collectComments) {
@@ -100,6 +136,25 @@ bool Reader::parse(const char* beginDoc,
                    const char* endDoc,
                    Value& root,
                    bool collectComments) {
+  arena_ = 0;
+  return readDocument(beginDoc, endDoc, root, collectComments);
+}
+
+bool Reader::parse(const char* beginDoc,
+                   const char* endDoc,
+                   Document& doc,
+                   bool useArena) {
+  Value& root = doc.resetRoot(useArena);
+  arena_ = doc.usesArena() ? &doc.arena_ : 0;
+  // Comments and source offsets live outside the tree and would outlive an
+  // arena that is dropped without walking it.
+  return readDocument(beginDoc, endDoc, root, arena_ == 0);
+}
+
+bool Reader::readDocument(const char* beginDoc,
+                          const char* endDoc,
+                          Value& root,
+                          bool collectComments) {
   if (!features_.allowComments_) {
     collectComments = false;
   }
@@ -107,6 +162,7 @@ bool Reader::parse(const char* beginDoc,
   begin_ = beginDoc;
   end_ = endDoc;
   collectComments_ = collectComments;
+  collectOffsets_ = features_.collectOffsets_ && !arena_;
   current_ = begin_;
   lastValueEnd_ = 0;
   lastValue_ = 0;
@@ -137,6 +193,36 @@ bool Reader::parse(const char* beginDoc,
   return successful;
 }
 
+/** Read one element of a root array from [beginElement, endElement), which
+ * runs up to the ',' or ']' after it. Positions still count from beginDoc.
+ * Comments are skipped.
+ */
+bool Reader::readElement(const char* beginDoc,
+                         const char* beginElement,
+                         const char* endElement,
+                         Value& element) {
+  arena_ = 0;
+  begin_ = beginDoc;
+  end_ = endElement;
+  collectComments_ = false;
+  collectOffsets_ = features_.collectOffsets_;
+  current_ = beginElement;
+  lastValueEnd_ = 0;
+  lastValue_ = 0;
+  errors_.clear();
+  while (!nodes_.empty())
+    nodes_.pop();
+  nodes_.push(&element);
+
+  if (!readValue())
+    return false;
+  Token token;
+  skipCommentTokens(token);
+  if (token.type_ != tokenEndOfStream)
+    return addError("Missing ',' or ']' in array declaration", token);
+  return true;
+}
+
 bool Reader::readValue() {
   Token token;
   skipCommentTokens(token);
@@ -150,11 +236,11 @@ bool Reader::readValue() {
   switch (token.type_) {
   case tokenObjectBegin:
     successful = readObject(token);
-    currentValue().setOffsetLimit(current_ - begin_);
+    recordOffsetLimit(current_);
     break;
   case tokenArrayBegin:
     successful = readArray(token);
-    currentValue().setOffsetLimit(current_ - begin_);
+    recordOffsetLimit(current_);
     break;
   case tokenNumber:
     successful = decodeNumber(token);
@@ -166,24 +252,24 @@ bool Reader::readValue() {
     {
     Value v(true);
     currentValue().swapPayload(v);
-    currentValue().setOffsetStart(token.start_ - begin_);
-    currentValue().setOffsetLimit(token.end_ - begin_);
+    recordOffsetStart(token.start_);
+    recordOffsetLimit(token.end_);
     }
     break;
   case tokenFalse:
     {
     Value v(false);
     currentValue().swapPayload(v);
-    currentValue().setOffsetStart(token.start_ - begin_);
-    currentValue().setOffsetLimit(token.end_ - begin_);
+    recordOffsetStart(token.start_);
+    recordOffsetLimit(token.end_);
     }
     break;
   case tokenNull:
     {
     Value v;
     currentValue().swapPayload(v);
-    currentValue().setOffsetStart(token.start_ - begin_);
-    currentValue().setOffsetLimit(token.end_ - begin_);
+    recordOffsetStart(token.start_);
+    recordOffsetLimit(token.end_);
     }
     break;
   case tokenArraySeparator:
@@ -193,14 +279,14 @@ bool Reader::readValue() {
       current_--;
       Value v;
       currentValue().swapPayload(v);
-      currentValue().setOffsetStart(current_ - begin_ - 1);
-      currentValue().setOffsetLimit(current_ - begin_);
+      recordOffsetStart(current_ - 1);
+      recordOffsetLimit(current_);
       break;
     }
   // Else, fall through...
   default:
-    currentValue().setOffsetStart(token.start_ - begin_);
-    currentValue().setOffsetLimit(token.end_ - begin_);
+    recordOffsetStart(token.start_);
+    recordOffsetLimit(token.end_);
     return addError("Syntax error: value, object or array expected.", token);
   }
 
@@ -212,6 +298,16 @@ bool Reader::readValue() {
   return successful;
 }
 
+void Reader::recordOffsetStart(Location start) {
+  if (collectOffsets_)
+    currentValue().setOffsetStart(start - begin_);
+}
+
+void Reader::recordOffsetLimit(Location limit) {
+  if (collectOffsets_)
+    currentValue().setOffsetLimit(limit - begin_);
+}
+
 void Reader::skipCommentTokens(Token& token) {
   if (features_.allowComments_) {
     do {
@@ -430,9 +526,9 @@ bool Reader::readString() {
 bool Reader::readObject(Token& tokenStart) {
   Token tokenName;
   std::string name;
-  Value init(objectValue);
+  Value init(objectValue, arena_);
   currentValue().swapPayload(init);
-  currentValue().setOffsetStart(tokenStart.start_ - begin_);
+  recordOffsetStart(tokenStart.start_);
   while (readToken(tokenName)) {
     bool initialTokenOk = true;
     while (tokenName.type_ == tokenComment && initialTokenOk)
@@ -459,7 +555,7 @@ bool Reader::readObject(Token& tokenStart) {
       return addErrorAndRecover(
           "Missing ':' after object member name", colon, tokenObjectEnd);
     }
-    Value& value = currentValue()[name];
+    Value& value = resolveMember(name);
     nodes_.push(&value);
     bool ok = readValue();
     nodes_.pop();
@@ -483,10 +579,21 @@ bool Reader::readObject(Token& tokenStart) {
       "Missing '}' or object member name", tokenName, tokenObjectEnd);
 }
 
+Value& Reader::resolveMember(const std::string& name) {
+  // Pooled and arena names outlive the tree, so the member can point at
+  // them instead of owning a copy.
+  if (features_.internKeys_)
+    return currentValue()[Key(name)];
+  if (arena_)
+    return currentValue()[StaticString(
+        arena_->duplicate(name.data(), name.length()))];
+  return currentValue()[name];
+}
+
 bool Reader::readArray(Token& tokenStart) {
-  Value init(arrayValue);
+  Value init(arrayValue, arena_);
   currentValue().swapPayload(init);
-  currentValue().setOffsetStart(tokenStart.start_ - begin_);
+  recordOffsetStart(tokenStart.start_);
   skipSpaces();
   if (*current_ == ']') // empty array
   {
@@ -526,8 +633,8 @@ bool Reader::decodeNumber(Token& token) {
   if (!decodeNumber(token, decoded))
     return false;
   currentValue().swapPayload(decoded);
-  currentValue().setOffsetStart(token.start_ - begin_);
-  currentValue().setOffsetLimit(token.end_ - begin_);
+  recordOffsetStart(token.start_);
+  recordOffsetLimit(token.end_);
   return true;
 }
 
@@ -576,12 +683,19 @@ bool Reader::decodeDouble(Token& token) {
   if (!decodeDouble(token, decoded))
     return false;
   currentValue().swapPayload(decoded);
-  currentValue().setOffsetStart(token.start_ - begin_);
-  currentValue().setOffsetLimit(token.end_ - begin_);
+  recordOffsetStart(token.start_);
+  recordOffsetLimit(token.end_);
   return true;
 }
 
 bool Reader::decodeDouble(Token& token, Value& decoded) {
+  // The writers copy a lazy real's token as it is, so only a number of the
+  // RFC 8259 grammar may stay lazy; sscanf() below takes the rest.
+  if (features_.lazyNumbers_ && isStrictNumber(token.start_, token.end_)) {
+    decoded.setLazyReal(token.start_, token.end_, arena_);
+    return true;
+  }
+
   double value = 0;
   const int bufferSize = 32;
   int count;
@@ -621,10 +735,16 @@ bool Reader::decodeString(Token& token) {
   std::string decoded_string;
   if (!decodeString(token, decoded_string))
     return false;
-  Value decoded(decoded_string);
-  currentValue().swapPayload(decoded);
-  currentValue().setOffsetStart(token.start_ - begin_);
-  currentValue().setOffsetLimit(token.end_ - begin_);
+  if (arena_) {
+    Value decoded(StaticString(
+        arena_->duplicate(decoded_string.data(), decoded_string.length())));
+    currentValue().swapPayload(decoded);
+  } else {
+    Value decoded(decoded_string);
+    currentValue().swapPayload(decoded);
+  }
+  recordOffsetStart(token.start_);
+  recordOffsetLimit(token.end_);
   return true;
 }
 
@@ -892,12 +1012,15 @@ bool Reader::good() const {
 
 class OldReader : public CharReader {
   bool const collectComments_;
+  bool const useArena_;
   Reader reader_;
 public:
   OldReader(
     bool collectComments,
+    bool useArena,
     Features const& features)
   : collectComments_(collectComments)
+  , useArena_(useArena)
   , reader_(features)
   {}
   virtual bool parse(
@@ -909,17 +1032,27 @@ public:
     }
     return ok;
   }
+  virtual bool parse(
+      char const* beginDoc, char const* endDoc,
+      Document* doc, std::string* errs) {
+    bool ok = reader_.parse(beginDoc, endDoc, *doc, useArena_);
+    if (errs) {
+      *errs = reader_.getFormattedErrorMessages();
+    }
+    return ok;
+  }
 };
 
 CharReaderBuilder::CharReaderBuilder()
   : collectComments_(true)
   , features_(Features::all())
+  , useArena_(false)
 {}
 CharReaderBuilder::~CharReaderBuilder()
 {}
 CharReader* CharReaderBuilder::newCharReader() const
 {
-  return new OldReader(collectComments_, features_);
+  return new OldReader(collectComments_, useArena_, features_);
 }
 
 //////////////////////////////////
@@ -939,6 +1072,19 @@ bool parseFromStream(
   return reader->parse(begin, end, root, errs);
 }
 
+bool parseFromStream(
+    CharReader::Factory const& fact, std::istream& sin,
+    Document* doc, std::string* errs)
+{
+  std::ostringstream ssin;
+  ssin << sin.rdbuf();
+  std::string text = ssin.str();
+  char const* begin = text.data();
+  char const* end = begin + text.size();
+  CharReaderPtr const reader(fact.newCharReader());
+  return reader->parse(begin, end, doc, errs);
+}
+
 std::istream& operator>>(std::istream& sin, Value& root) {
   CharReaderBuilder b;
   std::string errs;
@@ -0,0 +1,362 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <json/assertions.h>
+#include <json/pointer.h>
+#include <json/snapshot.h>
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string.h>
+#include <utility>
+#include <vector>
+#if defined(JSON_HAS_THREADS)
+#include <atomic>
+#endif
+
+namespace Json {
+
+// class Snapshot::Node
+// //////////////////////////////////////////////////////////////////
+
+/** One immutable node, shared by every Snapshot that refers to it.
+ * Objects keep their members sorted by name, as Value does. The names are
+ * plain copies rather than Keys, so a snapshot never adds to the Key pool.
+ */
+struct Snapshot::Node {
+  explicit Node(ValueType type) : refs_(1), hash_(0), type_(type) {}
+
+  void rehash();
+
+#if defined(JSON_HAS_THREADS)
+  std::atomic<unsigned int> refs_;
+#else
+  unsigned int refs_;
+#endif
+  Value::LargestUInt hash_;
+  ValueType type_;
+  Value scalar_;                   // all but arrays and objects
+  std::vector<std::string> names_; // objects
+  std::vector<Snapshot> children_; // arrays and objects
+};
+
+static inline void combineHash(Value::LargestUInt& hash,
+                               Value::LargestUInt value) {
+  hash ^= value + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+}
+
+/// 32-bit FNV-1a hash of a member name.
+static unsigned int hashName(const std::string& name) {
+  unsigned int hash = 2166136261u;
+  for (size_t index = 0; index < name.size(); ++index) {
+    hash ^= static_cast<unsigned char>(name[index]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void Snapshot::Node::rehash() {
+  if (type_ != arrayValue && type_ != objectValue) {
+    hash_ = scalar_.hash();
+    return;
+  }
+  hash_ = type_;
+  for (size_t index = 0; index < children_.size(); ++index) {
+    if (type_ == objectValue)
+      combineHash(hash_, hashName(names_[index]));
+    combineHash(hash_, children_[index].hash());
+  }
+}
+
+/// Index of the first name not less than \a name.
+static size_t lowerBound(const std::vector<std::string>& names,
+                         const char* name) {
+  size_t begin = 0;
+  size_t end = names.size();
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    if (strcmp(names[middle].c_str(), name) < 0)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  return begin;
+}
+
+static inline bool
+sameName(const std::string& name, const char* text, size_t length) {
+  return name.size() == length && memcmp(name.data(), text, length) == 0;
+}
+
+// Zero-initialized, so usable before this file's initializers run.
+static const Snapshot nullSnapshot;
+
+// class Snapshot
+// //////////////////////////////////////////////////////////////////
+
+Snapshot::Snapshot() : node_(0) {}
+
+Snapshot::Snapshot(Node* node) : node_(node) {}
+
+Snapshot::Snapshot(const Value& value) : node_(build(value, 0)) {}
+
+Snapshot::Snapshot(const Value& value, const Snapshot& previous)
+    : node_(build(value, &previous)) {}
+
+Snapshot::Snapshot(const Snapshot& other) : node_(other.node_) {
+  if (node_)
+    ++node_->refs_;
+}
+
+Snapshot::~Snapshot() {
+  if (node_ && --node_->refs_ == 0)
+    delete node_;
+}
+
+Snapshot& Snapshot::operator=(Snapshot other) {
+  swap(other);
+  return *this;
+}
+
+void Snapshot::swap(Snapshot& other) { std::swap(node_, other.node_); }
+
+Snapshot::Node* Snapshot::build(const Value& value, const Snapshot* previous) {
+  const Node* old = previous ? previous->node_ : 0;
+  Node* node;
+  switch (value.type()) {
+  case nullValue:
+    return 0;
+  case arrayValue:
+    node = new Node(arrayValue);
+    node->children_.reserve(value.size());
+    for (ArrayIndex index = 0; index < value.size(); ++index) {
+      const Snapshot* oldChild =
+          old && old->type_ == arrayValue && index < old->children_.size()
+              ? &old->children_[index]
+              : 0;
+      node->children_.push_back(Snapshot(build(value[index], oldChild)));
+    }
+    break;
+  case objectValue:
+    node = new Node(objectValue);
+    node->names_.reserve(value.size());
+    node->children_.reserve(value.size());
+    for (Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+      const char* name = it.memberName();
+      const Snapshot* oldChild = 0;
+      if (old && old->type_ == objectValue) {
+        size_t at = lowerBound(old->names_, name);
+        if (at < old->names_.size() && old->names_[at] == name)
+          oldChild = &old->children_[at];
+      }
+      node->names_.push_back(name);
+      node->children_.push_back(Snapshot(build(*it, oldChild)));
+    }
+    break;
+  // Scalars are rebuilt from their payload, so that the comments and source
+  // offsets of the tree do not take entries of the side table.
+  case realValue:
+    node = new Node(realValue);
+    node->scalar_ = value.asDouble();
+    break;
+  case stringValue:
+    node = new Node(stringValue);
+    node->scalar_ = value.asCString();
+    break;
+  case intValue:
+    node = new Node(intValue);
+    node->scalar_ = value.asLargestInt();
+    break;
+  case uintValue:
+    node = new Node(uintValue);
+    node->scalar_ = value.asLargestUInt();
+    break;
+  case booleanValue:
+    node = new Node(booleanValue);
+    node->scalar_ = value.asBool();
+    break;
+  default:
+    node = new Node(value.type());
+    break;
+  }
+  node->rehash();
+
+  // Unchanged children are shared already, so this compare is shallow.
+  Snapshot built(node);
+  if (old && built == *previous) {
+    ++previous->node_->refs_;
+    return previous->node_; // built drops the new node
+  }
+  built.node_ = 0;
+  return node;
+}
+
+ValueType Snapshot::type() const { return node_ ? node_->type_ : nullValue; }
+
+bool Snapshot::isNull() const { return node_ == 0; }
+
+ArrayIndex Snapshot::size() const {
+  return node_ ? ArrayIndex(node_->children_.size()) : 0;
+}
+
+const Snapshot& Snapshot::operator[](const Key& key) const {
+  const Snapshot* child = find(key);
+  return child ? *child : nullSnapshot;
+}
+
+const Snapshot& Snapshot::operator[](ArrayIndex index) const {
+  if (type() != arrayValue || index >= node_->children_.size())
+    return nullSnapshot;
+  return node_->children_[index];
+}
+
+const Snapshot* Snapshot::find(const Key& key) const {
+  return findName(key.c_str(), key.length());
+}
+
+const Snapshot* Snapshot::findName(const char* name, size_t length) const {
+  if (type() != objectValue)
+    return 0;
+  size_t index = lowerBound(node_->names_, name);
+  if (index == node_->names_.size() ||
+      !sameName(node_->names_[index], name, length))
+    return 0;
+  return &node_->children_[index];
+}
+
+const Snapshot* Snapshot::find(const CompiledPath& path) const {
+  if (!path.isValid())
+    return 0;
+  const Snapshot* node = this;
+  for (CompiledPath::Steps::const_iterator it = path.steps_.begin();
+       node && it != path.steps_.end();
+       ++it) {
+    if (node->type() == objectValue && it->isName_)
+      node = node->findName(it->name_.c_str(), it->name_.size());
+    else if (node->type() == arrayValue && it->isIndex_ &&
+             it->index_ < node->size())
+      node = &(*node)[it->index_];
+    else
+      node = 0;
+  }
+  return node;
+}
+
+const char* Snapshot::memberName(ArrayIndex index) const {
+  JSON_ASSERT_MESSAGE(type() == objectValue && index < size(),
+                      "in Json::Snapshot::memberName(): requires a member "
+                      "index of an object");
+  return node_->names_[index].c_str();
+}
+
+const Value& Snapshot::scalar() const {
+  if (!node_ || node_->type_ == arrayValue || node_->type_ == objectValue)
+    return Value::null;
+  return node_->scalar_;
+}
+
+std::string Snapshot::asString() const { return scalar().asString(); }
+
+Value::Int Snapshot::asInt() const { return scalar().asInt(); }
+
+Value::UInt Snapshot::asUInt() const { return scalar().asUInt(); }
+
+double Snapshot::asDouble() const { return scalar().asDouble(); }
+
+bool Snapshot::asBool() const { return scalar().asBool(); }
+
+Value Snapshot::toValue() const {
+  switch (type()) {
+  case arrayValue: {
+    Value value(arrayValue);
+    for (ArrayIndex index = 0; index < size(); ++index)
+      value.append(node_->children_[index].toValue());
+    return value;
+  }
+  case objectValue: {
+    Value value(objectValue);
+    for (ArrayIndex index = 0; index < size(); ++index)
+      value[node_->names_[index]] = node_->children_[index].toValue();
+    return value;
+  }
+  default:
+    return scalar();
+  }
+}
+
+Snapshot Snapshot::with(const CompiledPath& path, const Snapshot& value) const {
+  JSON_ASSERT_MESSAGE(path.isValid(), path.error());
+  return replace(*this, path, 0, value);
+}
+
+Snapshot Snapshot::replace(const Snapshot& node,
+                           const CompiledPath& path,
+                           size_t step,
+                           const Snapshot& value) {
+  if (step == path.steps_.size())
+    return value;
+  const CompiledPath::Step& current = path.steps_[step];
+  ValueType type = node.type();
+  JSON_ASSERT_MESSAGE(type == nullValue || type == arrayValue ||
+                          type == objectValue,
+                      "in Json::Snapshot::with(): " + path.text() +
+                          " goes through a scalar");
+  bool asArray = type == arrayValue || (type == nullValue && !current.isName_);
+
+  // Copy this level only: its children are shared.
+  Snapshot copy(new Node(asArray ? arrayValue : objectValue));
+  std::vector<std::string>& names = copy.node_->names_;
+  std::vector<Snapshot>& children = copy.node_->children_;
+  if (type != nullValue) {
+    names = node.node_->names_;
+    children = node.node_->children_;
+  }
+  if (asArray) {
+    size_t index = children.size();
+    if (!current.isAppend_) {
+      JSON_ASSERT_MESSAGE(current.isIndex_,
+                          "in Json::Snapshot::with(): "
+                          "array elements need a numeric step");
+      index = current.index_;
+    }
+    if (index >= children.size())
+      children.resize(index + 1);
+    children[index] = replace(children[index], path, step + 1, value);
+  } else {
+    size_t index = lowerBound(names, current.name_.c_str());
+    if (index == names.size() || names[index] != current.name_) {
+      names.insert(names.begin() + index, current.name_);
+      children.insert(children.begin() + index, Snapshot());
+    }
+    children[index] = replace(children[index], path, step + 1, value);
+  }
+  copy.node_->rehash();
+  return copy;
+}
+
+Value::LargestUInt Snapshot::hash() const {
+  return node_ ? node_->hash_ : Value::null.hash();
+}
+
+bool Snapshot::shares(const Snapshot& other) const {
+  return node_ == other.node_;
+}
+
+bool Snapshot::operator==(const Snapshot& other) const {
+  if (node_ == other.node_)
+    return true;
+  if (!node_ || !other.node_ || node_->hash_ != other.node_->hash_ ||
+      node_->type_ != other.node_->type_)
+    return false;
+  if (node_->type_ != arrayValue && node_->type_ != objectValue)
+    return node_->scalar_ == other.node_->scalar_;
+  return node_->names_ == other.node_->names_ &&
+         node_->children_ == other.node_->children_;
+}
+
+bool Snapshot::operator!=(const Snapshot& other) const {
+  return !(*this == other);
+}
+
+} // namespace Json
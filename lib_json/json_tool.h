@@ -82,6 +82,28 @@ static inline void fixNumericLocale(char* begin, char* end) {
   }
 }
 
+/** Decodes an array index in JSON Pointer form.
+ * @return true if \a token is "0" or digits without a leading zero that fit
+ *         in an ArrayIndex.
+ */
+static inline bool decodeArrayIndex(const std::string& token,
+                                    ArrayIndex& index) {
+  if (token.empty() || (token[0] == '0' && token.size() > 1))
+    return false;
+  ArrayIndex value = 0;
+  for (std::string::const_iterator it = token.begin(); it != token.end();
+       ++it) {
+    if (*it < '0' || *it > '9')
+      return false;
+    ArrayIndex digit = ArrayIndex(*it - '0');
+    if (value > (ArrayIndex(-1) - digit) / 10)
+      return false;
+    value = value * 10 + digit;
+  }
+  index = value;
+  return true;
+}
+
 } // namespace Json {
 
 #endif // LIB_JSONCPP_JSON_TOOL_H_INCLUDED
@@ -12,6 +12,7 @@
 #endif // #ifndef JSON_USE_SIMPLE_INTERNAL_ALLOCATOR
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <math.h>
+#include <stdio.h>
 #include <sstream>
 #include <utility>
 #include <cstring>
@@ -20,6 +21,10 @@
 #include <cpptl/conststring.h>
 #endif
 #include <cstddef> // size_t
+#if defined(JSON_HAS_THREADS)
+#include <atomic>
+#include <mutex>
+#endif
 
 #define JSON_ASSERT_UNREACHABLE assert(false)
 
@@ -76,6 +81,17 @@ static inline bool InRange(double d, T min, U max) {
 }
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
 
+// The installed MemoryHooks, or NULL for malloc() and free(). Zero-initialized,
+// so Values built by other static initializers can already allocate.
+static MemoryHooks* memoryHooks;
+
+static inline void releaseMemory(void* block, size_t size) {
+  if (memoryHooks)
+    memoryHooks->release(block, size);
+  else
+    free(block);
+}
+
 /** Duplicates the specified string value.
  * @param value Pointer to the string to duplicate. Must be zero-terminated if
  *              length is "unknown".
@@ -93,7 +109,8 @@ static inline char* duplicateStringValue(const char* value,
   if (length >= (unsigned)Value::maxInt)
     length = Value::maxInt - 1;
 
-  char* newString = static_cast<char*>(malloc(length + 1));
+  char* newString = static_cast<char*>(
+      memoryHooks ? memoryHooks->allocate(length + 1) : malloc(length + 1));
   JSON_ASSERT_MESSAGE(newString != 0,
                       "in Json::Value::duplicateStringValue(): "
                       "Failed to allocate string value buffer");
@@ -104,7 +121,63 @@ static inline char* duplicateStringValue(const char* value,
 
 /** Free the string duplicated by duplicateStringValue().
  */
-static inline void releaseStringValue(char* value) { free(value); }
+static inline void releaseStringValue(char* value) {
+  releaseMemory(value, memoryHooks ? strlen(value) + 1 : 0);
+}
+
+#ifndef JSON_VALUE_USE_INTERNAL_MAP
+/** Return the arena the nodes of \a map come from, or NULL for the heap.
+ */
+static inline ValueArena* arenaOf(const Value::ObjectValues& map) {
+#ifndef JSON_USE_CPPTL_SMALLMAP
+  return map.get_allocator().arena();
+#else
+  (void)map;
+  return 0;
+#endif
+}
+
+/** Create an empty heap-backed map, or a copy of the heap-backed \a other.
+ */
+static inline Value::ObjectValues*
+newObjectValues(const Value::ObjectValues* other = 0) {
+  typedef Value::ObjectValues ObjectValues;
+  void* block = MemoryHooks::allocateBlock(sizeof(ObjectValues));
+  return other ? new (block) ObjectValues(*other) : new (block) ObjectValues();
+}
+
+/** Free a map created by Value(ValueType) or Value(ValueType, ValueArena*).
+ * An arena-backed map lives in its arena: only run its destructor.
+ */
+static inline void releaseObjectValues(Value::ObjectValues* map) {
+  typedef Value::ObjectValues ObjectValues;
+  ValueArena* arena = arenaOf(*map);
+  map->~ObjectValues();
+  if (!arena)
+    releaseMemory(map, sizeof(ObjectValues));
+}
+#endif // ifndef JSON_VALUE_USE_INTERNAL_MAP
+
+/** A real read with Features::lazyNumbers_: its source token, followed by
+ * the value once it has been asked for.
+ *
+ * Reading the value is const, so several threads may decode the same token
+ * at once. The first to claim the state stores the value; the others return
+ * their own decoding, which is the same number.
+ */
+struct Value::LazyReal {
+  enum State { undecoded, decoding, decoded };
+
+  LazyReal() : value_(0.0), state_(undecoded) {}
+
+  double value_;
+#if defined(JSON_HAS_THREADS)
+  std::atomic<unsigned char> state_;
+#else
+  unsigned char state_;
+#endif
+  char token_[1]; // zero-terminated, allocated past the end of the struct
+};
 
 } // namespace Json
 
@@ -129,29 +202,396 @@ namespace Json {
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
-// class Value::CommentInfo
+// class ValueExtraTable
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 
-Value::CommentInfo::CommentInfo() : comment_(0) {}
+/** Comments and source offsets of one Value.
+ */
+struct ValueExtra {
+  char* comments_[numberOfCommentPlacement];
+  size_t start_;
+  size_t limit_;
+  unsigned int nextFree_;
+};
+
+/** Process-wide side table holding the ValueExtra of every Value that has
+ * one, addressed by Value::extra_.
+ *
+ * Entries live in fixed-size pages that never move, so an entry can be read
+ * without locking once its index is known. Each page keeps its own free
+ * list, and a page is deleted once all its entries are back, except for one
+ * empty page kept so that a Value built and destroyed in a loop does not
+ * allocate a page each time.
+ *
+ * Only take() and give() lock the table. Threads go through a small cache
+ * of their own (see ValueExtraCache), so they lock it once per batch of
+ * entries rather than once per Value.
+ */
+class ValueExtraTable {
+public:
+  enum {
+    pageBits = 12,
+    pageSize = 1 << pageBits,
+    maxPages = 1 << 14
+  };
+
+  /// Move \a count entries out of the table into \a indices.
+  void take(unsigned int* indices, unsigned int count);
+  /// Give back the \a count entries in \a indices.
+  void give(const unsigned int* indices, unsigned int count);
+  Value::ExtraStatistics statistics();
+
+  ValueExtra& operator[](unsigned int index) {
+    return pages_[index >> pageBits]->entries_[index & (pageSize - 1)];
+  }
 
-Value::CommentInfo::~CommentInfo() {
-  if (comment_)
-    releaseStringValue(comment_);
+private:
+  struct Page {
+    ValueExtra entries_[pageSize];
+    unsigned int freeList_; // first free entry of this page, or 0
+    unsigned int used_;     // entries out of the table
+    Page* previous_;        // neighbours in the list of pages with free
+    Page* next_;            // entries
+  };
+
+  Page* newPage();
+  void link(Page* page);
+  void unlink(Page* page);
+
+  Page* pages_[maxPages];
+  Page* partial_;   // pages with free entries
+  Page* spare_;     // the empty page kept, or 0
+  size_t pageCount_;
+  size_t used_;
+  size_t locks_;
+#if defined(JSON_HAS_THREADS)
+  std::mutex mutex_;
+#endif
+};
+
+ValueExtraTable::Page* ValueExtraTable::newPage() {
+  unsigned int number = 0;
+  while (number < maxPages && pages_[number])
+    ++number;
+  JSON_ASSERT_MESSAGE(number < maxPages,
+                      "in Json::Value: too many values with comments or "
+                      "source offsets");
+  Page* page = new Page;
+  // Index 0 means no entry, so the first entry of page 0 is never used.
+  unsigned int first = number ? 0 : 1;
+  unsigned int base = number << pageBits;
+  for (unsigned int entry = first; entry + 1 < pageSize; ++entry)
+    page->entries_[entry].nextFree_ = base + entry + 1;
+  page->entries_[pageSize - 1].nextFree_ = 0;
+  page->freeList_ = base + first;
+  page->used_ = 0;
+  pages_[number] = page;
+  ++pageCount_;
+  link(page);
+  return page;
+}
+
+void ValueExtraTable::link(Page* page) {
+  page->previous_ = 0;
+  page->next_ = partial_;
+  if (partial_)
+    partial_->previous_ = page;
+  partial_ = page;
+}
+
+void ValueExtraTable::unlink(Page* page) {
+  if (page->previous_)
+    page->previous_->next_ = page->next_;
+  else
+    partial_ = page->next_;
+  if (page->next_)
+    page->next_->previous_ = page->previous_;
 }
 
-void Value::CommentInfo::setComment(const char* text, size_t len) {
-  if (comment_) {
-    releaseStringValue(comment_);
-    comment_ = 0;
+void ValueExtraTable::take(unsigned int* indices, unsigned int count) {
+#if defined(JSON_HAS_THREADS)
+  std::lock_guard<std::mutex> lock(mutex_);
+#endif
+  ++locks_;
+  used_ += count;
+  while (count) {
+    Page* page = partial_ ? partial_ : newPage();
+    if (page == spare_)
+      spare_ = 0;
+    while (count && page->freeList_) {
+      unsigned int index = page->freeList_;
+      page->freeList_ = (*this)[index].nextFree_;
+      ++page->used_;
+      *indices++ = index;
+      --count;
+    }
+    if (!page->freeList_)
+      unlink(page);
   }
-  JSON_ASSERT(text != 0);
-  JSON_ASSERT_MESSAGE(
-      text[0] == '\0' || text[0] == '/',
-      "in Json::Value::setComment(): Comments must start with /");
-  // It seems that /**/ style comments are acceptable as well.
-  comment_ = duplicateStringValue(text, len);
+}
+
+void ValueExtraTable::give(const unsigned int* indices, unsigned int count) {
+#if defined(JSON_HAS_THREADS)
+  std::lock_guard<std::mutex> lock(mutex_);
+#endif
+  ++locks_;
+  used_ -= count;
+  for (; count; --count) {
+    unsigned int index = *indices++;
+    unsigned int number = index >> pageBits;
+    Page* page = pages_[number];
+    if (!page->freeList_)
+      link(page);
+    (*this)[index].nextFree_ = page->freeList_;
+    page->freeList_ = index;
+    if (--page->used_)
+      continue;
+    if (!spare_) {
+      spare_ = page;
+      continue;
+    }
+    unlink(page);
+    pages_[number] = 0;
+    --pageCount_;
+    delete page;
+  }
+}
+
+Value::ExtraStatistics ValueExtraTable::statistics() {
+#if defined(JSON_HAS_THREADS)
+  std::lock_guard<std::mutex> lock(mutex_);
+#endif
+  Value::ExtraStatistics stats;
+  stats.entries = used_;
+  stats.pages = pageCount_;
+  stats.bytes = pageCount_ * sizeof(Page);
+  stats.locks = locks_;
+  return stats;
+}
+
+// Zero-initialized before any dynamic initialization runs, so Values built
+// by other static initializers can already use it.
+static ValueExtraTable valueExtras;
+
+// thread_local came with Visual Studio 2015.
+#if defined(JSON_HAS_THREADS) && (!defined(_MSC_VER) || _MSC_VER >= 1900)
+#define JSON_EXTRA_CACHE 1
+#endif
+
+#if defined(JSON_EXTRA_CACHE)
+/** Entries a thread took from valueExtras or freed, kept to hand out again
+ * without locking. Refilled and drained one batch at a time.
+ *
+ * Plain data, so it is usable at any point of the thread's life. The entries
+ * go back to the table when the thread exits, through ValueExtraCacheOwner.
+ */
+struct ValueExtraCache {
+  enum { batchSize = 64 };
+  unsigned int indices_[2 * batchSize];
+  unsigned int count_;
+  bool closed_; // the thread is exiting: use the table directly
+};
+
+static thread_local ValueExtraCache valueExtraCache;
+
+struct ValueExtraCacheOwner {
+  ~ValueExtraCacheOwner() {
+    if (valueExtraCache.count_)
+      valueExtras.give(valueExtraCache.indices_, valueExtraCache.count_);
+    valueExtraCache.count_ = 0;
+    valueExtraCache.closed_ = true;
+  }
+};
+
+static thread_local ValueExtraCacheOwner valueExtraCacheOwner;
+#endif
+
+/// Return the index of a cleared entry.
+static unsigned int acquireExtra() {
+  unsigned int index;
+#if defined(JSON_EXTRA_CACHE)
+  ValueExtraCache& cache = valueExtraCache;
+  if (!cache.closed_) {
+    if (!cache.count_) {
+      (void)&valueExtraCacheOwner; // registers its destructor
+      valueExtras.take(cache.indices_, ValueExtraCache::batchSize);
+      cache.count_ = ValueExtraCache::batchSize;
+    }
+    index = cache.indices_[--cache.count_];
+  } else {
+    valueExtras.take(&index, 1);
+  }
+#else
+  valueExtras.take(&index, 1);
+#endif
+  ValueExtra& extra = valueExtras[index];
+  for (int comment = 0; comment < numberOfCommentPlacement; ++comment)
+    extra.comments_[comment] = 0;
+  extra.start_ = 0;
+  extra.limit_ = 0;
+  return index;
+}
+
+static void releaseExtra(unsigned int index) {
+  ValueExtra& extra = valueExtras[index];
+  for (int comment = 0; comment < numberOfCommentPlacement; ++comment) {
+    if (extra.comments_[comment])
+      releaseStringValue(extra.comments_[comment]);
+  }
+#if defined(JSON_EXTRA_CACHE)
+  ValueExtraCache& cache = valueExtraCache;
+  if (!cache.closed_) {
+    if (cache.count_ == 2 * ValueExtraCache::batchSize) {
+      cache.count_ -= ValueExtraCache::batchSize;
+      valueExtras.give(cache.indices_ + cache.count_,
+                       ValueExtraCache::batchSize);
+    } else if (!cache.count_) {
+      (void)&valueExtraCacheOwner;
+    }
+    cache.indices_[cache.count_++] = index;
+    return;
+  }
+#endif
+  valueExtras.give(&index, 1);
+}
+
+Value::ExtraStatistics Value::extraStatistics() {
+  return valueExtras.statistics();
+}
+
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Key
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+static inline unsigned int hashKeyText(const char* text, unsigned int length) {
+  unsigned int hash = 2166136261u;
+  for (unsigned int index = 0; index < length; ++index) {
+    hash ^= static_cast<unsigned char>(text[index]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/** Process-wide pool of member names, shared by every Key with equal text.
+ *
+ * An open-addressing hash set of zero-terminated copies. The copies are
+ * never freed, so pointers into the pool stay valid until exit. Like
+ * valueExtras it is only zero-initialized, because static Keys in other
+ * translation units may be built before this file's initializers run.
+ */
+class KeyPool {
+public:
+  const char* intern(const char* text, unsigned int length, unsigned int hash);
+  Key::PoolStatistics statistics();
+
+private:
+  struct Slot {
+    const char* text_;
+    unsigned int length_;
+    unsigned int hash_;
+  };
+
+  void grow();
+
+  Slot* slots_;
+  unsigned int capacity_; // 0 or a power of 2
+  unsigned int count_;
+  size_t lookups_;
+  size_t hits_;
+  size_t textBytes_;
+#if defined(JSON_HAS_THREADS)
+  std::mutex mutex_;
+#endif
+};
+
+const char*
+KeyPool::intern(const char* text, unsigned int length, unsigned int hash) {
+#if defined(JSON_HAS_THREADS)
+  std::lock_guard<std::mutex> lock(mutex_);
+#endif
+  if ((count_ + 1) * 2 > capacity_)
+    grow();
+  ++lookups_;
+  unsigned int index = hash & (capacity_ - 1);
+  for (;;) {
+    Slot& slot = slots_[index];
+    if (!slot.text_) {
+      // Pooled text lives until exit, so it does not use the MemoryHooks.
+      char* copy = static_cast<char*>(malloc(length + 1));
+      JSON_ASSERT_MESSAGE(copy != 0,
+                          "in Json::Key::Key(): Failed to allocate key text");
+      memcpy(copy, text, length);
+      copy[length] = 0;
+      slot.text_ = copy;
+      slot.length_ = length;
+      slot.hash_ = hash;
+      ++count_;
+      textBytes_ += length + 1;
+      return slot.text_;
+    }
+    if (slot.hash_ == hash && slot.length_ == length &&
+        memcmp(slot.text_, text, length) == 0) {
+      ++hits_;
+      return slot.text_;
+    }
+    index = (index + 1) & (capacity_ - 1);
+  }
+}
+
+void KeyPool::grow() {
+  unsigned int capacity = capacity_ ? capacity_ * 2 : 64;
+  Slot* slots = static_cast<Slot*>(calloc(capacity, sizeof(Slot)));
+  JSON_ASSERT_MESSAGE(slots != 0,
+                      "in Json::Key::Key(): Failed to allocate key pool");
+  for (unsigned int old = 0; old < capacity_; ++old) {
+    if (!slots_[old].text_)
+      continue;
+    unsigned int index = slots_[old].hash_ & (capacity - 1);
+    while (slots[index].text_)
+      index = (index + 1) & (capacity - 1);
+    slots[index] = slots_[old];
+  }
+  free(slots_);
+  slots_ = slots;
+  capacity_ = capacity;
+}
+
+Key::PoolStatistics KeyPool::statistics() {
+#if defined(JSON_HAS_THREADS)
+  std::lock_guard<std::mutex> lock(mutex_);
+#endif
+  Key::PoolStatistics stats;
+  stats.lookups = lookups_;
+  stats.hits = hits_;
+  stats.names = count_;
+  stats.bytes = textBytes_ + capacity_ * sizeof(Slot);
+  return stats;
+}
+
+static KeyPool keyPool;
+
+Key::Key(const char* name) { init(name, (unsigned int)strlen(name)); }
+
+Key::Key(const std::string& name) {
+  init(name.c_str(), (unsigned int)name.length());
+}
+
+Key::Key(const char* name, size_t length) {
+  init(name, (unsigned int)length);
+}
+
+Key::PoolStatistics Key::poolStatistics() { return keyPool.statistics(); }
+
+void Key::init(const char* name, unsigned int length) {
+  length_ = length;
+  hash_ = hashKeyText(name, length);
+  cstr_ = keyPool.intern(name, length, hash_);
 }
 
 // //////////////////////////////////////////////////////////////////
@@ -197,14 +637,18 @@ Value::CZString& Value::CZString::operator=(CZString other) {
 }
 
 bool Value::CZString::operator<(const CZString& other) const {
-  if (cstr_)
+  if (cstr_) {
+    // Names from a Key or a StaticString are often the very same buffer.
+    if (cstr_ == other.cstr_)
+      return false;
     return strcmp(cstr_, other.cstr_) < 0;
+  }
   return index_ < other.index_;
 }
 
 bool Value::CZString::operator==(const CZString& other) const {
   if (cstr_)
-    return strcmp(cstr_, other.cstr_) == 0;
+    return cstr_ == other.cstr_ || strcmp(cstr_, other.cstr_) == 0;
   return index_ == other.index_;
 }
 
@@ -246,7 +690,51 @@ Value::Value(ValueType type) {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = newObjectValues();
+    break;
+#else
+  case arrayValue:
+    value_.array_ = arrayAllocator()->newArray();
+    break;
+  case objectValue:
+    value_.map_ = mapAllocator()->newMap();
+    break;
+#endif
+  case booleanValue:
+    value_.bool_ = false;
+    break;
+  default:
+    JSON_ASSERT_UNREACHABLE;
+  }
+}
+
+Value::Value(ValueType type, ValueArena* arena) {
+  initBasic(type);
+  (void)arena; // only the std::map containers take an arena
+  switch (type) {
+  case nullValue:
+    break;
+  case intValue:
+  case uintValue:
+    value_.int_ = 0;
+    break;
+  case realValue:
+    value_.real_ = 0.0;
+    break;
+  case stringValue:
+    value_.string_ = 0;
+    break;
+#ifndef JSON_VALUE_USE_INTERNAL_MAP
+  case arrayValue:
+  case objectValue:
+#ifndef JSON_USE_CPPTL_SMALLMAP
+    if (arena) {
+      value_.map_ = new (arena->allocate(sizeof(ObjectValues)))
+          ObjectValues(std::less<CZString>(), ObjectValues::allocator_type(arena));
+      break;
+    }
+#endif
+    value_.map_ = newObjectValues();
     break;
 #else
   case arrayValue:
@@ -324,21 +812,32 @@ Value::Value(bool value) {
 }
 
 Value::Value(const Value& other)
-    : type_(other.type_), allocated_(false)
+    : type_(other.type_), allocated_(false), lazy_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
 #endif
       ,
-      comments_(0), start_(other.start_), limit_(other.limit_) {
+      extra_(0) {
   switch (type_) {
   case nullValue:
   case intValue:
   case uintValue:
-  case realValue:
   case booleanValue:
     value_ = other.value_;
     break;
+  case realValue:
+    if (other.lazy_) {
+      const LazyReal* real = other.value_.lazyReal_;
+      setLazyReal(real->token_, real->token_ + strlen(real->token_), 0);
+      if (real->state_ == LazyReal::decoded) {
+        value_.lazyReal_->value_ = real->value_;
+        value_.lazyReal_->state_ = LazyReal::decoded;
+      }
+    } else {
+      value_ = other.value_;
+    }
+    break;
   case stringValue:
     if (other.value_.string_) {
       value_.string_ = duplicateStringValue(other.value_.string_);
@@ -351,7 +850,24 @@ Value::Value(const Value& other)
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    if (arenaOf(*other.value_.map_)) {
+      // Member names of an arena-backed object point into the arena: the
+      // copy gets its own, and its nodes come from the heap.
+      value_.map_ = newObjectValues();
+      ObjectValues::const_iterator itOther = other.value_.map_->begin();
+      for (; itOther != other.value_.map_->end(); ++itOther) {
+        const CZString& key = itOther->first;
+        ObjectValues::value_type defaultValue(
+            key.c_str() ? CZString(key.c_str(), CZString::duplicateOnCopy)
+                        : key,
+            null);
+        ObjectValues::iterator it =
+            value_.map_->insert(value_.map_->end(), defaultValue);
+        it->second = itOther->second;
+      }
+    } else {
+      value_.map_ = newObjectValues(other.value_.map_);
+    }
     break;
 #else
   case arrayValue:
@@ -364,14 +880,17 @@ Value::Value(const Value& other)
   default:
     JSON_ASSERT_UNREACHABLE;
   }
-  if (other.comments_) {
-    comments_ = new CommentInfo[numberOfCommentPlacement];
+  if (other.extra_) {
+    extra_ = acquireExtra();
+    const ValueExtra& otherExtra = valueExtras[other.extra_];
+    ValueExtra& extra = valueExtras[extra_];
     for (int comment = 0; comment < numberOfCommentPlacement; ++comment) {
-      const CommentInfo& otherComment = other.comments_[comment];
-      if (otherComment.comment_)
-        comments_[comment].setComment(
-            otherComment.comment_, strlen(otherComment.comment_));
+      if (otherExtra.comments_[comment])
+        extra.comments_[comment] =
+            duplicateStringValue(otherExtra.comments_[comment]);
     }
+    extra.start_ = otherExtra.start_;
+    extra.limit_ = otherExtra.limit_;
   }
 }
 
@@ -380,9 +899,13 @@ Value::~Value() {
   case nullValue:
   case intValue:
   case uintValue:
-  case realValue:
   case booleanValue:
     break;
+  case realValue:
+    if (lazy_ && allocated_)
+      releaseMemory(value_.lazyReal_,
+                    sizeof(LazyReal) + strlen(value_.lazyReal_->token_));
+    break;
   case stringValue:
     if (allocated_)
       releaseStringValue(value_.string_);
@@ -390,7 +913,7 @@ Value::~Value() {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    releaseObjectValues(value_.map_);
     break;
 #else
   case arrayValue:
@@ -404,8 +927,8 @@ Value::~Value() {
     JSON_ASSERT_UNREACHABLE;
   }
 
-  if (comments_)
-    delete[] comments_;
+  if (extra_)
+    releaseExtra(extra_);
 }
 
 Value& Value::operator=(Value other) {
@@ -421,64 +944,82 @@ void Value::swapPayload(Value& other) {
   int temp2 = allocated_;
   allocated_ = other.allocated_;
   other.allocated_ = temp2;
+  temp2 = lazy_;
+  lazy_ = other.lazy_;
+  other.lazy_ = temp2;
 }
 
 void Value::swap(Value& other) {
   swapPayload(other);
-  std::swap(comments_, other.comments_);
-  std::swap(start_, other.start_);
-  std::swap(limit_, other.limit_);
+  std::swap(extra_, other.extra_);
 }
 
 ValueType Value::type() const { return type_; }
 
-int Value::compare(const Value& other) const {
-  if (*this < other)
-    return -1;
-  if (*this > other)
-    return 1;
-  return 0;
+template <typename T> static inline int compareScalars(T a, T b) {
+  return a < b ? -1 : b < a ? 1 : 0;
 }
 
-bool Value::operator<(const Value& other) const {
+int Value::compare(const Value& other) const {
+  // One three-way pass: deriving this from operator< and operator> would
+  // visit each level of a nested tree twice, and so take exponential time.
   int typeDelta = type_ - other.type_;
   if (typeDelta)
-    return typeDelta < 0 ? true : false;
+    return typeDelta < 0 ? -1 : 1;
   switch (type_) {
   case nullValue:
-    return false;
+    return 0;
   case intValue:
-    return value_.int_ < other.value_.int_;
+    return compareScalars(value_.int_, other.value_.int_);
   case uintValue:
-    return value_.uint_ < other.value_.uint_;
+    return compareScalars(value_.uint_, other.value_.uint_);
   case realValue:
-    return value_.real_ < other.value_.real_;
+    return compareScalars(realPayload(), other.realPayload());
   case booleanValue:
-    return value_.bool_ < other.value_.bool_;
+    return compareScalars(value_.bool_, other.value_.bool_);
   case stringValue:
-    return (value_.string_ == 0 && other.value_.string_) ||
-           (other.value_.string_ && value_.string_ &&
-            strcmp(value_.string_, other.value_.string_) < 0);
+    if (!value_.string_ || !other.value_.string_)
+      return compareScalars(value_.string_ != 0, other.value_.string_ != 0);
+    return compareScalars(strcmp(value_.string_, other.value_.string_), 0);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue: {
     int delta = int(value_.map_->size() - other.value_.map_->size());
     if (delta)
-      return delta < 0;
-    return (*value_.map_) < (*other.value_.map_);
+      return delta < 0 ? -1 : 1;
+    // Same order as comparing the maps: member name or index, then value.
+    ObjectValues::const_iterator it = value_.map_->begin();
+    ObjectValues::const_iterator itOther = other.value_.map_->begin();
+    for (; it != value_.map_->end(); ++it, ++itOther) {
+      int order;
+      if (it->first.c_str() && it->first.c_str() != itOther->first.c_str())
+        order = compareScalars(strcmp(it->first.c_str(),
+                                      itOther->first.c_str()), 0);
+      else if (it->first.c_str())
+        order = 0;
+      else
+        order = compareScalars(it->first.index(), itOther->first.index());
+      if (!order)
+        order = it->second.compare(itOther->second);
+      if (order)
+        return order;
+    }
+    return 0;
   }
 #else
   case arrayValue:
-    return value_.array_->compare(*(other.value_.array_)) < 0;
+    return compareScalars(value_.array_->compare(*(other.value_.array_)), 0);
   case objectValue:
-    return value_.map_->compare(*(other.value_.map_)) < 0;
+    return compareScalars(value_.map_->compare(*(other.value_.map_)), 0);
 #endif
   default:
     JSON_ASSERT_UNREACHABLE;
   }
-  return false; // unreachable
+  return 0; // unreachable
 }
 
+bool Value::operator<(const Value& other) const { return compare(other) < 0; }
+
 bool Value::operator<=(const Value& other) const { return !(other < *this); }
 
 bool Value::operator>=(const Value& other) const { return !(*this < other); }
@@ -501,7 +1042,7 @@ bool Value::operator==(const Value& other) const {
   case uintValue:
     return value_.uint_ == other.value_.uint_;
   case realValue:
-    return value_.real_ == other.value_.real_;
+    return realPayload() == other.realPayload();
   case booleanValue:
     return value_.bool_ == other.value_.bool_;
   case stringValue:
@@ -527,6 +1068,185 @@ bool Value::operator==(const Value& other) const {
 
 bool Value::operator!=(const Value& other) const { return !(*this == other); }
 
+#if defined(JSON_HAS_INT64)
+// 64-bit FNV-1a, spelled without 64-bit literals.
+static const Value::LargestUInt hashOffsetBasis =
+    (Value::LargestUInt(0xcbf29ce4u) << 32) | 0x84222325u;
+static const Value::LargestUInt hashPrime =
+    (Value::LargestUInt(0x100u) << 32) | 0x1b3u;
+#else
+static const Value::LargestUInt hashOffsetBasis = 2166136261u;
+static const Value::LargestUInt hashPrime = 16777619u;
+#endif
+
+static inline void
+hashBytes(Value::LargestUInt& hash, const void* data, size_t length) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t index = 0; index < length; ++index) {
+    hash ^= bytes[index];
+    hash *= hashPrime;
+  }
+}
+
+template <typename T>
+static inline void hashPod(Value::LargestUInt& hash, T value) {
+  hashBytes(hash, &value, sizeof(value));
+}
+
+Value::LargestUInt Value::hash() const {
+  LargestUInt hash = hashOffsetBasis;
+  hashPod(hash, static_cast<unsigned char>(type_));
+  switch (type_) {
+  case nullValue:
+    return hash;
+  case intValue:
+    hashPod(hash, value_.int_);
+    return hash;
+  case uintValue:
+    hashPod(hash, value_.uint_);
+    return hash;
+  case realValue: {
+    // 0.0 == -0.0, so both must hash alike.
+    double real = realPayload();
+    hashPod(hash, real == 0.0 ? 0.0 : real);
+    return hash;
+  }
+  case booleanValue:
+    hashPod(hash, static_cast<unsigned char>(value_.bool_));
+    return hash;
+  case stringValue:
+    if (value_.string_)
+      hashBytes(hash, value_.string_, strlen(value_.string_));
+    return hash;
+  case arrayValue:
+  case objectValue:
+    break;
+  default:
+    JSON_ASSERT_UNREACHABLE;
+  }
+
+  // Mix in each member's name or index and then its own hash.
+  hashPod(hash, size());
+  for (const_iterator it = begin(); it != end(); ++it) {
+    if (type_ == objectValue) {
+      const char* name = it.memberName();
+      hashBytes(hash, name, strlen(name) + 1);
+    } else {
+      hashPod(hash, it.index());
+    }
+    hashPod(hash, (*it).hash());
+  }
+  return hash;
+}
+
+static inline void addOwnedText(Value::Footprint& footprint, size_t length) {
+  ++footprint.allocations;
+  footprint.bytes += length + 1;
+  footprint.textBytes += length + 1;
+}
+
+// A red-black tree node as libstdc++, libc++ and MSVC lay it out: three
+// links and a colour, padded to a fourth, ahead of the member.
+static const size_t mapNodeOverhead = 4 * sizeof(void*);
+
+Value::Footprint Value::memoryFootprint() const {
+  Footprint footprint;
+  footprint.values = 1;
+  footprint.allocations = 0;
+  footprint.bytes = 0;
+  footprint.textBytes = 0;
+  switch (type_) {
+  case realValue:
+    if (lazy_ && allocated_) {
+      size_t length = strlen(value_.lazyReal_->token_);
+      addOwnedText(footprint, length);
+      footprint.bytes += sizeof(LazyReal) - 1;
+    }
+    break;
+  case stringValue:
+    if (allocated_ && value_.string_)
+      addOwnedText(footprint, strlen(value_.string_));
+    break;
+  case arrayValue:
+  case objectValue: {
+#ifndef JSON_VALUE_USE_INTERNAL_MAP
+    const bool onHeap = arenaOf(*value_.map_) == 0;
+    if (onHeap) {
+      ++footprint.allocations;
+      footprint.bytes += sizeof(ObjectValues);
+    }
+    ObjectValues::const_iterator it = value_.map_->begin();
+    for (; it != value_.map_->end(); ++it) {
+      if (onHeap) {
+        ++footprint.allocations;
+        footprint.bytes += sizeof(ObjectValues::value_type) + mapNodeOverhead;
+      }
+      const CZString& key = it->first;
+      if (key.c_str() && !key.isStaticString())
+        addOwnedText(footprint, strlen(key.c_str()));
+      Footprint child = it->second.memoryFootprint();
+#else
+    for (const_iterator it = begin(); it != end(); ++it) {
+      Footprint child = (*it).memoryFootprint();
+#endif
+      footprint.values += child.values;
+      footprint.allocations += child.allocations;
+      footprint.bytes += child.bytes;
+      footprint.textBytes += child.textBytes;
+    }
+  } break;
+  default:
+    break;
+  }
+  if (extra_) {
+    const ValueExtra& extra = valueExtras[extra_];
+    for (int comment = 0; comment < numberOfCommentPlacement; ++comment) {
+      if (extra.comments_[comment])
+        addOwnedText(footprint, strlen(extra.comments_[comment]));
+    }
+  }
+  return footprint;
+}
+
+void Value::setLazyReal(const char* begin,
+                        const char* end,
+                        ValueArena* arena) {
+  size_t length = end - begin;
+  size_t size = sizeof(LazyReal) + length;
+  void* block = arena ? arena->allocate(size)
+                      : MemoryHooks::allocateBlock(size);
+  JSON_ASSERT_MESSAGE(block != 0,
+                      "in Json::Value::setLazyReal(): "
+                      "Failed to allocate number token");
+  LazyReal* real = new (block) LazyReal();
+  memcpy(real->token_, begin, length);
+  real->token_[length] = 0;
+  type_ = realValue;
+  allocated_ = arena == 0;
+  lazy_ = true;
+  value_.lazyReal_ = real;
+}
+
+double Value::realPayload() const {
+  if (!lazy_)
+    return value_.real_;
+  LazyReal* real = value_.lazyReal_;
+  if (real->state_ == LazyReal::decoded)
+    return real->value_;
+  // The Reader checked the token, and decodes eager reals the same way.
+  double value = 0.0;
+  char format[] = "%lf";
+  sscanf(real->token_, format, &value);
+#if defined(JSON_HAS_THREADS)
+  unsigned char expected = LazyReal::undecoded;
+  if (!real->state_.compare_exchange_strong(expected, LazyReal::decoding))
+    return value;
+#endif
+  real->value_ = value;
+  real->state_ = LazyReal::decoded;
+  return value;
+}
+
 const char* Value::asCString() const {
   JSON_ASSERT_MESSAGE(type_ == stringValue,
                       "in Json::Value::asCString(): requires stringValue");
@@ -546,7 +1266,7 @@ std::string Value::asString() const {
   case uintValue:
     return valueToString(value_.uint_);
   case realValue:
-    return valueToString(value_.real_);
+    return valueToString(realPayload());
   default:
     JSON_FAIL_MESSAGE("Type is not convertible to string");
   }
@@ -567,9 +1287,9 @@ Value::Int Value::asInt() const {
     JSON_ASSERT_MESSAGE(isInt(), "LargestUInt out of Int range");
     return Int(value_.uint_);
   case realValue:
-    JSON_ASSERT_MESSAGE(InRange(value_.real_, minInt, maxInt),
+    JSON_ASSERT_MESSAGE(InRange(realPayload(), minInt, maxInt),
                         "double out of Int range");
-    return Int(value_.real_);
+    return Int(realPayload());
   case nullValue:
     return 0;
   case booleanValue:
@@ -589,9 +1309,9 @@ Value::UInt Value::asUInt() const {
     JSON_ASSERT_MESSAGE(isUInt(), "LargestUInt out of UInt range");
     return UInt(value_.uint_);
   case realValue:
-    JSON_ASSERT_MESSAGE(InRange(value_.real_, 0, maxUInt),
+    JSON_ASSERT_MESSAGE(InRange(realPayload(), 0, maxUInt),
                         "double out of UInt range");
-    return UInt(value_.real_);
+    return UInt(realPayload());
   case nullValue:
     return 0;
   case booleanValue:
@@ -612,9 +1332,9 @@ Value::Int64 Value::asInt64() const {
     JSON_ASSERT_MESSAGE(isInt64(), "LargestUInt out of Int64 range");
     return Int64(value_.uint_);
   case realValue:
-    JSON_ASSERT_MESSAGE(InRange(value_.real_, minInt64, maxInt64),
+    JSON_ASSERT_MESSAGE(InRange(realPayload(), minInt64, maxInt64),
                         "double out of Int64 range");
-    return Int64(value_.real_);
+    return Int64(realPayload());
   case nullValue:
     return 0;
   case booleanValue:
@@ -633,9 +1353,9 @@ Value::UInt64 Value::asUInt64() const {
   case uintValue:
     return UInt64(value_.uint_);
   case realValue:
-    JSON_ASSERT_MESSAGE(InRange(value_.real_, 0, maxUInt64),
+    JSON_ASSERT_MESSAGE(InRange(realPayload(), 0, maxUInt64),
                         "double out of UInt64 range");
-    return UInt64(value_.real_);
+    return UInt64(realPayload());
   case nullValue:
     return 0;
   case booleanValue:
@@ -674,7 +1394,7 @@ double Value::asDouble() const {
     return integerToDouble(value_.uint_);
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
   case realValue:
-    return value_.real_;
+    return realPayload();
   case nullValue:
     return 0.0;
   case booleanValue:
@@ -696,7 +1416,7 @@ float Value::asFloat() const {
     return integerToDouble(value_.uint_);
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
   case realValue:
-    return static_cast<float>(value_.real_);
+    return static_cast<float>(realPayload());
   case nullValue:
     return 0.0;
   case booleanValue:
@@ -718,13 +1438,17 @@ bool Value::asBool() const {
   case uintValue:
     return value_.uint_ ? true : false;
   case realValue:
-    return value_.real_ ? true : false;
+    return realPayload() ? true : false;
   default:
     break;
   }
   JSON_FAIL_MESSAGE("Value is not convertible to bool.");
 }
 
+const char* Value::numberToken() const {
+  return type_ == realValue && lazy_ ? value_.lazyReal_->token_ : 0;
+}
+
 bool Value::isConvertibleTo(ValueType other) const {
   switch (other) {
   case nullValue:
@@ -736,11 +1460,11 @@ bool Value::isConvertibleTo(ValueType other) const {
            type_ == nullValue;
   case intValue:
     return isInt() ||
-           (type_ == realValue && InRange(value_.real_, minInt, maxInt)) ||
+           (type_ == realValue && InRange(realPayload(), minInt, maxInt)) ||
            type_ == booleanValue || type_ == nullValue;
   case uintValue:
     return isUInt() ||
-           (type_ == realValue && InRange(value_.real_, 0, maxUInt)) ||
+           (type_ == realValue && InRange(realPayload(), 0, maxUInt)) ||
            type_ == booleanValue || type_ == nullValue;
   case realValue:
     return isNumeric() || type_ == booleanValue || type_ == nullValue;
@@ -802,8 +1526,8 @@ void Value::clear() {
   JSON_ASSERT_MESSAGE(type_ == nullValue || type_ == arrayValue ||
                           type_ == objectValue,
                       "in Json::Value::clear(): requires complex value");
-  start_ = 0;
-  limit_ = 0;
+  setOffsetStart(0);
+  setOffsetLimit(0);
   switch (type_) {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
@@ -904,12 +1628,11 @@ Value& Value::operator[](const char* key) {
 void Value::initBasic(ValueType type, bool allocated) {
   type_ = type;
   allocated_ = allocated;
+  lazy_ = false;
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   itemIsUsed_ = 0;
 #endif
-  comments_ = 0;
-  start_ = 0;
-  limit_ = 0;
+  extra_ = 0;
 }
 
 Value& Value::resolveReference(const char* key, bool isStatic) {
@@ -971,6 +1694,35 @@ Value& Value::operator[](const StaticString& key) {
   return resolveReference(key, true);
 }
 
+Value& Value::operator[](const Key& key) {
+  // Pooled text is never freed, so the member can point at it.
+  return resolveReference(key.c_str(), true);
+}
+
+const Value& Value::operator[](const Key& key) const {
+  JSON_ASSERT_MESSAGE(
+      type_ == nullValue || type_ == objectValue,
+      "in Json::Value::operator[](Key const&)const: requires objectValue");
+  const Value* value = find(key);
+  return value ? *value : null;
+}
+
+const Value* Value::find(const Key& key) const { return find(key.c_str()); }
+
+const Value* Value::find(const char* key) const {
+  if (type_ != objectValue)
+    return 0;
+#ifndef JSON_VALUE_USE_INTERNAL_MAP
+  CZString actualKey(key, CZString::noDuplication);
+  ObjectValues::const_iterator it = value_.map_->find(actualKey);
+  if (it == value_.map_->end())
+    return 0;
+  return &(*it).second;
+#else
+  return value_.map_->find(key);
+#endif
+}
+
 #ifdef JSON_USE_CPPTL
 Value& Value::operator[](const CppTL::ConstString& key) {
   return (*this)[key.c_str()];
@@ -1146,9 +1898,10 @@ bool Value::isInt() const {
     return value_.int_ >= minInt && value_.int_ <= maxInt;
   case uintValue:
     return value_.uint_ <= UInt(maxInt);
-  case realValue:
-    return value_.real_ >= minInt && value_.real_ <= maxInt &&
-           IsIntegral(value_.real_);
+  case realValue: {
+    double real = realPayload();
+    return real >= minInt && real <= maxInt && IsIntegral(real);
+  }
   default:
     break;
   }
@@ -1161,9 +1914,10 @@ bool Value::isUInt() const {
     return value_.int_ >= 0 && LargestUInt(value_.int_) <= LargestUInt(maxUInt);
   case uintValue:
     return value_.uint_ <= maxUInt;
-  case realValue:
-    return value_.real_ >= 0 && value_.real_ <= maxUInt &&
-           IsIntegral(value_.real_);
+  case realValue: {
+    double real = realPayload();
+    return real >= 0 && real <= maxUInt && IsIntegral(real);
+  }
   default:
     break;
   }
@@ -1177,12 +1931,14 @@ bool Value::isInt64() const {
     return true;
   case uintValue:
     return value_.uint_ <= UInt64(maxInt64);
-  case realValue:
+  case realValue: {
     // Note that maxInt64 (= 2^63 - 1) is not exactly representable as a
     // double, so double(maxInt64) will be rounded up to 2^63. Therefore we
     // require the value to be strictly less than the limit.
-    return value_.real_ >= double(minInt64) &&
-           value_.real_ < double(maxInt64) && IsIntegral(value_.real_);
+    double real = realPayload();
+    return real >= double(minInt64) && real < double(maxInt64) &&
+           IsIntegral(real);
+  }
   default:
     break;
   }
@@ -1197,12 +1953,13 @@ bool Value::isUInt64() const {
     return value_.int_ >= 0;
   case uintValue:
     return true;
-  case realValue:
+  case realValue: {
     // Note that maxUInt64 (= 2^64 - 1) is not exactly representable as a
     // double, so double(maxUInt64) will be rounded up to 2^64. Therefore we
     // require the value to be strictly less than the limit.
-    return value_.real_ >= 0 && value_.real_ < maxUInt64AsDouble &&
-           IsIntegral(value_.real_);
+    double real = realPayload();
+    return real >= 0 && real < maxUInt64AsDouble && IsIntegral(real);
+  }
   default:
     break;
   }
@@ -1229,13 +1986,21 @@ bool Value::isArray() const { return type_ == arrayValue; }
 bool Value::isObject() const { return type_ == objectValue; }
 
 void Value::setComment(const char* comment, size_t len, CommentPlacement placement) {
-  if (!comments_)
-    comments_ = new CommentInfo[numberOfCommentPlacement];
+  JSON_ASSERT(comment != 0);
+  JSON_ASSERT_MESSAGE(
+      comment[0] == '\0' || comment[0] == '/',
+      "in Json::Value::setComment(): Comments must start with /");
+  // It seems that /**/ style comments are acceptable as well.
   if ((len > 0) && (comment[len-1] == '\n')) {
     // Always discard trailing newline, to aid indentation.
     len -= 1;
   }
-  comments_[placement].setComment(comment, len);
+  if (!extra_)
+    extra_ = acquireExtra();
+  char*& text = valueExtras[extra_].comments_[placement];
+  if (text)
+    releaseStringValue(text);
+  text = duplicateStringValue(comment, (unsigned int)len);
 }
 
 void Value::setComment(const char* comment, CommentPlacement placement) {
@@ -1247,22 +2012,40 @@ void Value::setComment(const std::string& comment, CommentPlacement placement) {
 }
 
 bool Value::hasComment(CommentPlacement placement) const {
-  return comments_ != 0 && comments_[placement].comment_ != 0;
+  return extra_ != 0 && valueExtras[extra_].comments_[placement] != 0;
 }
 
 std::string Value::getComment(CommentPlacement placement) const {
   if (hasComment(placement))
-    return comments_[placement].comment_;
+    return valueExtras[extra_].comments_[placement];
   return "";
 }
 
-void Value::setOffsetStart(size_t start) { start_ = start; }
+void Value::setOffsetStart(size_t start) {
+  if (!extra_) {
+    if (start == 0)
+      return;
+    extra_ = acquireExtra();
+  }
+  valueExtras[extra_].start_ = start;
+}
 
-void Value::setOffsetLimit(size_t limit) { limit_ = limit; }
+void Value::setOffsetLimit(size_t limit) {
+  if (!extra_) {
+    if (limit == 0)
+      return;
+    extra_ = acquireExtra();
+  }
+  valueExtras[extra_].limit_ = limit;
+}
 
-size_t Value::getOffsetStart() const { return start_; }
+size_t Value::getOffsetStart() const {
+  return extra_ ? valueExtras[extra_].start_ : 0;
+}
 
-size_t Value::getOffsetLimit() const { return limit_; }
+size_t Value::getOffsetLimit() const {
+  return extra_ ? valueExtras[extra_].limit_ : 0;
+}
 
 std::string Value::toStyledString() const {
   StyledWriter writer;
@@ -1389,6 +2172,267 @@ Value::iterator Value::end() {
   return iterator();
 }
 
+// class MemoryStatistics
+// //////////////////////////////////////////////////////////////////
+
+MemoryStatistics::MemoryStatistics()
+    : bytes(0), peakBytes(0), allocations(0), releases(0) {}
+
+// class MemoryHooks
+// //////////////////////////////////////////////////////////////////
+
+MemoryHooks::~MemoryHooks() {}
+
+void* MemoryHooks::allocate(size_t size) { return malloc(size); }
+
+void MemoryHooks::release(void* block, size_t) { free(block); }
+
+MemoryHooks* MemoryHooks::install(MemoryHooks* hooks) {
+  MemoryHooks* previous = memoryHooks;
+  memoryHooks = hooks;
+  return previous;
+}
+
+MemoryHooks* MemoryHooks::installed() { return memoryHooks; }
+
+void* MemoryHooks::allocateBlock(size_t size) {
+  void* block = memoryHooks ? memoryHooks->allocate(size) : malloc(size);
+  JSON_ASSERT_MESSAGE(block != 0,
+                      "in Json::MemoryHooks::allocateBlock(): "
+                      "Failed to allocate");
+  return block;
+}
+
+void MemoryHooks::releaseBlock(void* block, size_t size) {
+  releaseMemory(block, size);
+}
+
+// class MemoryCounter
+// //////////////////////////////////////////////////////////////////
+
+struct MemoryCounter::Counters {
+  Counters() : bytes_(0), peakBytes_(0), allocations_(0), releases_(0) {}
+
+#if defined(JSON_HAS_THREADS)
+  std::atomic<size_t> bytes_;
+  std::atomic<size_t> peakBytes_;
+  std::atomic<size_t> allocations_;
+  std::atomic<size_t> releases_;
+#else
+  size_t bytes_;
+  size_t peakBytes_;
+  size_t allocations_;
+  size_t releases_;
+#endif
+};
+
+MemoryCounter::MemoryCounter(MemoryHooks* next)
+    : next_(next), counters_(new Counters()) {}
+
+MemoryCounter::~MemoryCounter() { delete counters_; }
+
+void* MemoryCounter::allocate(size_t size) {
+  void* block = next_ ? next_->allocate(size) : malloc(size);
+  if (!block)
+    return 0;
+  ++counters_->allocations_;
+#if defined(JSON_HAS_THREADS)
+  size_t bytes = counters_->bytes_ += size;
+  size_t peak = counters_->peakBytes_.load();
+  while (bytes > peak &&
+         !counters_->peakBytes_.compare_exchange_weak(peak, bytes)) {
+  }
+#else
+  size_t bytes = counters_->bytes_ += size;
+  if (bytes > counters_->peakBytes_)
+    counters_->peakBytes_ = bytes;
+#endif
+  return block;
+}
+
+void MemoryCounter::release(void* block, size_t size) {
+  if (!block)
+    return;
+  ++counters_->releases_;
+#if defined(JSON_HAS_THREADS)
+  size_t bytes = counters_->bytes_.load();
+  while (!counters_->bytes_.compare_exchange_weak(
+             bytes, bytes > size ? bytes - size : 0)) {
+  }
+#else
+  size_t& bytes = counters_->bytes_;
+  bytes = bytes > size ? bytes - size : 0;
+#endif
+  if (next_)
+    next_->release(block, size);
+  else
+    free(block);
+}
+
+MemoryStatistics MemoryCounter::statistics() const {
+  MemoryStatistics stats;
+  stats.bytes = counters_->bytes_;
+  stats.peakBytes = counters_->peakBytes_;
+  stats.allocations = counters_->allocations_;
+  stats.releases = counters_->releases_;
+  return stats;
+}
+
+void MemoryCounter::reset() {
+  counters_->bytes_ = 0;
+  counters_->peakBytes_ = 0;
+  counters_->allocations_ = 0;
+  counters_->releases_ = 0;
+}
+
+// class ValueArena
+// //////////////////////////////////////////////////////////////////
+
+struct ValueArena::Chunk {
+  Chunk* next_;
+  size_t size_; // header included
+};
+
+// Every block handed out is a multiple of this, which is enough for the
+// nodes of a Value tree.
+static const size_t arenaAlignment = 8;
+static const size_t arenaMinChunkSize = 4096;
+static const size_t arenaMaxChunkSize = 256 * 1024;
+
+static inline size_t alignArenaSize(size_t size) {
+  return (size + arenaAlignment - 1) & ~(arenaAlignment - 1);
+}
+
+ValueArena::ValueArena()
+    : chunks_(0), current_(0), limit_(0), used_(0), reserved_(0), blocks_(0),
+      peakReserved_(0) {}
+
+ValueArena::~ValueArena() { release(); }
+
+void* ValueArena::allocate(size_t size) {
+  size = alignArenaSize(size);
+  if (size > size_t(limit_ - current_))
+    return allocateFromNewChunk(size);
+  void* block = current_;
+  current_ += size;
+  used_ += size;
+  ++blocks_;
+  return block;
+}
+
+void* ValueArena::allocateFromNewChunk(size_t size) {
+  // Chunks double with the arena so that big documents need few of them.
+  size_t chunkSize = reserved_ < arenaMinChunkSize ? arenaMinChunkSize
+                                                   : reserved_;
+  if (chunkSize > arenaMaxChunkSize)
+    chunkSize = arenaMaxChunkSize;
+  if (chunkSize < size)
+    chunkSize = size;
+  const size_t headerSize = alignArenaSize(sizeof(Chunk));
+  Chunk* chunk = static_cast<Chunk*>(
+      MemoryHooks::allocateBlock(headerSize + chunkSize));
+  chunk->next_ = chunks_;
+  chunk->size_ = headerSize + chunkSize;
+  chunks_ = chunk;
+  reserved_ += chunkSize;
+  if (reserved_ > peakReserved_)
+    peakReserved_ = reserved_;
+
+  char* block = reinterpret_cast<char*>(chunk) + headerSize;
+  current_ = block + size;
+  limit_ = block + chunkSize;
+  used_ += size;
+  ++blocks_;
+  return block;
+}
+
+char* ValueArena::duplicate(const char* text, size_t length) {
+  char* newString = static_cast<char*>(allocate(length + 1));
+  memcpy(newString, text, length);
+  newString[length] = 0;
+  return newString;
+}
+
+void ValueArena::release() {
+  while (chunks_) {
+    Chunk* next = chunks_->next_;
+    releaseMemory(chunks_, chunks_->size_);
+    chunks_ = next;
+  }
+  current_ = limit_ = 0;
+  used_ = reserved_ = blocks_ = 0;
+}
+
+size_t ValueArena::used() const { return used_; }
+
+size_t ValueArena::reserved() const { return reserved_; }
+
+MemoryStatistics ValueArena::statistics() const {
+  MemoryStatistics stats;
+  stats.bytes = reserved_;
+  stats.peakBytes = peakReserved_;
+  stats.allocations = blocks_;
+  return stats;
+}
+
+// class Document
+// //////////////////////////////////////////////////////////////////
+
+Document::Document() : root_(0), useArena_(false), peakBytes_(0) {}
+
+Document::~Document() { clear(); }
+
+const Value& Document::root() const { return root_ ? *root_ : Value::null; }
+
+void Document::clear() {
+  // Every node of an arena tree lives in the arena, so there is nothing to
+  // walk: dropping the chunks drops the tree.
+  if (useArena_) {
+    arena_.release();
+  } else if (root_) {
+    root_->~Value();
+    releaseMemory(root_, sizeof(Value));
+  }
+  root_ = 0;
+  useArena_ = false;
+}
+
+bool Document::usesArena() const { return useArena_; }
+
+size_t Document::arenaSize() const { return arena_.reserved(); }
+
+MemoryStatistics Document::memoryStatistics() const {
+  MemoryStatistics stats;
+  if (useArena_) {
+    stats = arena_.statistics();
+  } else if (root_) {
+    Value::Footprint footprint = root_->memoryFootprint();
+    stats.bytes = sizeof(Value) + footprint.bytes;
+    stats.allocations = 1 + footprint.allocations;
+  }
+  size_t peak = stats.bytes > arena_.statistics().peakBytes
+                    ? stats.bytes
+                    : arena_.statistics().peakBytes;
+  if (peak > peakBytes_)
+    peakBytes_ = peak;
+  stats.peakBytes = peakBytes_;
+  return stats;
+}
+
+Value& Document::resetRoot(bool useArena) {
+  clear();
+#if defined(JSON_VALUE_USE_INTERNAL_MAP) || defined(JSON_USE_CPPTL_SMALLMAP)
+  // These containers cannot take their nodes from the arena.
+  useArena = false;
+#endif
+  useArena_ = useArena;
+  if (useArena_)
+    root_ = new (arena_.allocate(sizeof(Value))) Value();
+  else
+    root_ = new (MemoryHooks::allocateBlock(sizeof(Value))) Value();
+  return *root_;
+}
+
 // class PathArgument
 // //////////////////////////////////////////////////////////////////
 
@@ -4,9 +4,11 @@
 // See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
 
 #if !defined(JSON_IS_AMALGAMATION)
+#include <json/parallel.h>
 #include <json/writer.h>
 #include "json_tool.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
+#include <algorithm>
 #include <iomanip>
 #include <memory>
 #include <sstream>
@@ -120,6 +122,13 @@ std::string valueToString(double value) {
 
 std::string valueToString(bool value) { return value ? "true" : "false"; }
 
+/// A real as written: its source text if the Reader kept it, so that it
+/// round-trips unchanged.
+static std::string realToString(const Value& value) {
+  const char* token = value.numberToken();
+  return token ? std::string(token) : valueToString(value.asDouble());
+}
+
 std::string valueToQuotedString(const char* value) {
   if (value == NULL)
     return "";
@@ -189,9 +198,34 @@ Writer::~Writer() {}
 // Class FastWriter
 // //////////////////////////////////////////////////////////////////
 
+// Chunks per thread when writing in chunks. More than one evens out chunks
+// that take longer than others.
+static const size_t chunksPerThread = 4;
+
+/// Number of chunks to split \a size elements into on \a pool.
+static size_t chunkCount(WorkerPool& pool, size_t size) {
+  return std::min(size, size_t(pool.threads()) * chunksPerThread);
+}
+
+/// First element of \a chunk out of \a chunks.
+static size_t chunkBegin(size_t size, size_t chunks, size_t chunk) {
+  return size_t(Value::LargestUInt(size) * chunk / chunks);
+}
+
+/// Join the chunks written apart into \a document.
+static void joinChunks(std::string& document,
+                       const std::vector<std::string>& chunks) {
+  size_t length = document.length();
+  for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
+    length += chunks[chunk].length();
+  document.reserve(length);
+  for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
+    document += chunks[chunk];
+}
+
 FastWriter::FastWriter()
     : yamlCompatiblityEnabled_(false), dropNullPlaceholders_(false),
-      omitEndingLineFeed_(false) {}
+      omitEndingLineFeed_(false), pool_(0), parallelSize_(0) {}
 
 void FastWriter::enableYAMLCompatibility() { yamlCompatiblityEnabled_ = true; }
 
@@ -199,6 +233,11 @@ void FastWriter::dropNullPlaceholders() { dropNullPlaceholders_ = true; }
 
 void FastWriter::omitEndingLineFeed() { omitEndingLineFeed_ = true; }
 
+void FastWriter::useWorkerPool(WorkerPool* pool, ArrayIndex minimumSize) {
+  pool_ = pool;
+  parallelSize_ = minimumSize;
+}
+
 std::string FastWriter::write(const Value& root) {
   document_ = "";
   writeValue(root);
@@ -220,7 +259,7 @@ void FastWriter::writeValue(const Value& value) {
     document_ += valueToString(value.asLargestUInt());
     break;
   case realValue:
-    document_ += valueToString(value.asDouble());
+    document_ += realToString(value);
     break;
   case stringValue:
     document_ += valueToQuotedString(value.asCString());
@@ -230,36 +269,96 @@ void FastWriter::writeValue(const Value& value) {
     break;
   case arrayValue: {
     document_ += '[';
-    int size = value.size();
-    for (int index = 0; index < size; ++index) {
-      if (index > 0)
-        document_ += ',';
-      writeValue(value[index]);
-    }
+    if (!writeInChunks(value, 0))
+      writeElements(value, 0, value.size());
     document_ += ']';
   } break;
   case objectValue: {
     Value::Members members(value.getMemberNames());
     document_ += '{';
-    for (Value::Members::iterator it = members.begin(); it != members.end();
-         ++it) {
-      const std::string& name = *it;
-      if (it != members.begin())
-        document_ += ',';
-      document_ += valueToQuotedString(name.c_str());
-      document_ += yamlCompatiblityEnabled_ ? ": " : ":";
-      writeValue(value[name]);
-    }
+    if (!writeInChunks(value, &members))
+      writeMembers(value, members, 0, members.size());
     document_ += '}';
   } break;
   }
 }
 
+void
+FastWriter::writeElements(const Value& value, ArrayIndex begin, ArrayIndex end) {
+  for (ArrayIndex index = begin; index < end; ++index) {
+    if (index > 0)
+      document_ += ',';
+    writeValue(value[index]);
+  }
+}
+
+void FastWriter::writeMembers(const Value& value,
+                              const Value::Members& members,
+                              size_t begin,
+                              size_t end) {
+  for (size_t index = begin; index < end; ++index) {
+    const std::string& name = members[index];
+    if (index > 0)
+      document_ += ',';
+    document_ += valueToQuotedString(name.c_str());
+    document_ += yamlCompatiblityEnabled_ ? ": " : ":";
+    writeValue(value[name]);
+  }
+}
+
+/// One array or object written in chunks, shared by the tasks.
+struct FastWriter::ChunkJob {
+  const FastWriter* writer_;
+  const Value* value_;
+  const Value::Members* members_; // NULL for an array
+  size_t size_;
+  std::vector<std::string> chunks_;
+};
+
+void FastWriter::writeChunk(void* context, size_t chunk) {
+  ChunkJob& job = *static_cast<ChunkJob*>(context);
+  FastWriter writer;
+  writer.yamlCompatiblityEnabled_ = job.writer_->yamlCompatiblityEnabled_;
+  writer.dropNullPlaceholders_ = job.writer_->dropNullPlaceholders_;
+  size_t begin = chunkBegin(job.size_, job.chunks_.size(), chunk);
+  size_t end = chunkBegin(job.size_, job.chunks_.size(), chunk + 1);
+  if (job.members_)
+    writer.writeMembers(*job.value_, *job.members_, begin, end);
+  else
+    writer.writeElements(*job.value_, ArrayIndex(begin), ArrayIndex(end));
+  job.chunks_[chunk].swap(writer.document_);
+}
+
+/** Write the elements or members of \a value in chunks on pool_, if there
+ * are enough of them. Return false, having written nothing, otherwise.
+ */
+bool FastWriter::writeInChunks(const Value& value,
+                               const Value::Members* members) {
+  size_t size = members ? members->size() : value.size();
+  if (!pool_ || pool_->threads() < 2 || size < parallelSize_ || size < 2)
+    return false;
+  ChunkJob job;
+  job.writer_ = this;
+  job.value_ = &value;
+  job.members_ = members;
+  job.size_ = size;
+  job.chunks_.resize(chunkCount(*pool_, size));
+  pool_->run(job.chunks_.size(), &FastWriter::writeChunk, &job);
+  joinChunks(document_, job.chunks_);
+  return true;
+}
+
 // Class StyledWriter
 // //////////////////////////////////////////////////////////////////
 
 StyledWriter::StyledWriter()
-    : rightMargin_(74), indentSize_(3), addChildValues_() {}
+    : rightMargin_(74), indentSize_(3), addChildValues_(), pool_(0),
+      parallelSize_(0) {}
+
+void StyledWriter::useWorkerPool(WorkerPool* pool, ArrayIndex minimumSize) {
+  pool_ = pool;
+  parallelSize_ = minimumSize;
+}
 
 std::string StyledWriter::write(const Value& root) {
   document_ = "";
@@ -284,7 +383,7 @@ void StyledWriter::writeValue(const Value& value) {
     pushValue(valueToString(value.asLargestUInt()));
     break;
   case realValue:
-    pushValue(valueToString(value.asDouble()));
+    pushValue(realToString(value));
     break;
   case stringValue:
     pushValue(valueToQuotedString(value.asCString()));
@@ -302,21 +401,8 @@ void StyledWriter::writeValue(const Value& value) {
     else {
       writeWithIndent("{");
       indent();
-      Value::Members::iterator it = members.begin();
-      for (;;) {
-        const std::string& name = *it;
-        const Value& childValue = value[name];
-        writeCommentBeforeValue(childValue);
-        writeWithIndent(valueToQuotedString(name.c_str()));
-        document_ += " : ";
-        writeValue(childValue);
-        if (++it == members.end()) {
-          writeCommentAfterValueOnSameLine(childValue);
-          break;
-        }
-        document_ += ',';
-        writeCommentAfterValueOnSameLine(childValue);
-      }
+      if (!writeInChunks(value, &members))
+        writeMembers(value, members, 0, members.size());
       unindent();
       writeWithIndent("}");
     }
@@ -333,24 +419,9 @@ void StyledWriter::writeArrayValue(const Value& value) {
     if (isArrayMultiLine) {
       writeWithIndent("[");
       indent();
-      bool hasChildValue = !childValues_.empty();
-      unsigned index = 0;
-      for (;;) {
-        const Value& childValue = value[index];
-        writeCommentBeforeValue(childValue);
-        if (hasChildValue)
-          writeWithIndent(childValues_[index]);
-        else {
-          writeIndent();
-          writeValue(childValue);
-        }
-        if (++index == size) {
-          writeCommentAfterValueOnSameLine(childValue);
-          break;
-        }
-        document_ += ',';
-        writeCommentAfterValueOnSameLine(childValue);
-      }
+      // Elements already written into childValues_ are only copied out.
+      if (!childValues_.empty() || !writeInChunks(value, 0))
+        writeElements(value, 0, size);
       unindent();
       writeWithIndent("]");
     } else // output on a single line
@@ -367,6 +438,101 @@ void StyledWriter::writeArrayValue(const Value& value) {
   }
 }
 
+/// Write elements [begin, end) of a multi-line array.
+void StyledWriter::writeElements(const Value& value,
+                                 ArrayIndex begin,
+                                 ArrayIndex end) {
+  bool hasChildValue = !childValues_.empty();
+  for (ArrayIndex index = begin; index < end; ++index) {
+    const Value& childValue = value[index];
+    writeCommentBeforeValue(childValue);
+    if (hasChildValue)
+      writeWithIndent(childValues_[index]);
+    else {
+      writeIndent();
+      writeValue(childValue);
+    }
+    if (index + 1 != value.size())
+      document_ += ',';
+    writeCommentAfterValueOnSameLine(childValue);
+  }
+}
+
+void StyledWriter::writeMembers(const Value& value,
+                                const Value::Members& members,
+                                size_t begin,
+                                size_t end) {
+  for (size_t index = begin; index < end; ++index) {
+    const std::string& name = members[index];
+    const Value& childValue = value[name];
+    writeCommentBeforeValue(childValue);
+    writeWithIndent(valueToQuotedString(name.c_str()));
+    document_ += " : ";
+    writeValue(childValue);
+    if (index + 1 != members.size())
+      document_ += ',';
+    writeCommentAfterValueOnSameLine(childValue);
+  }
+}
+
+/// One array or object written in chunks, shared by the tasks.
+struct StyledWriter::ChunkJob {
+  const StyledWriter* writer_;
+  const Value* value_;
+  const Value::Members* members_; // NULL for an array
+  size_t size_;
+  std::vector<std::string> chunks_;
+};
+
+void StyledWriter::writeChunk(void* context, size_t chunk) {
+  ChunkJob& job = *static_cast<ChunkJob*>(context);
+  StyledWriter writer;
+  writer.rightMargin_ = job.writer_->rightMargin_;
+  writer.indentSize_ = job.writer_->indentSize_;
+  writer.indentString_ = job.writer_->indentString_;
+  // writeIndent() looks at the last character written. Before every chunk
+  // that is a ',', or the '[' or '{' that it treats the same way.
+  writer.document_ = ",";
+  size_t begin = chunkBegin(job.size_, job.chunks_.size(), chunk);
+  size_t end = chunkBegin(job.size_, job.chunks_.size(), chunk + 1);
+  if (job.members_)
+    writer.writeMembers(*job.value_, *job.members_, begin, end);
+  else
+    writer.writeElements(*job.value_, ArrayIndex(begin), ArrayIndex(end));
+  job.chunks_[chunk].assign(writer.document_, 1, std::string::npos);
+}
+
+/** Write the elements or members of \a value in chunks on pool_, if there
+ * are enough of them. Return false, having written nothing, otherwise.
+ *
+ * A comment after an element changes how the next one is indented, so a
+ * chunk may not start right after one.
+ */
+bool StyledWriter::writeInChunks(const Value& value,
+                                 const Value::Members* members) {
+  size_t size = members ? members->size() : value.size();
+  if (!pool_ || pool_->threads() < 2 || size < parallelSize_ || size < 2 ||
+      addChildValues_)
+    return false;
+  ChunkJob job;
+  job.writer_ = this;
+  job.value_ = &value;
+  job.members_ = members;
+  job.size_ = size;
+  job.chunks_.resize(chunkCount(*pool_, size));
+  for (size_t chunk = 1; chunk < job.chunks_.size(); ++chunk) {
+    size_t index = chunkBegin(size, job.chunks_.size(), chunk) - 1;
+    const Value& before = members ? value[(*members)[index]]
+                                  : value[ArrayIndex(index)];
+    if (before.hasComment(commentAfterOnSameLine) ||
+        before.hasComment(commentAfter))
+      return false;
+  }
+  pool_->run(job.chunks_.size(), &StyledWriter::writeChunk, &job);
+  joinChunks(document_, job.chunks_);
+  return true;
+}
+
 bool StyledWriter::isMultineArray(const Value& value) {
   int size = value.size();
   bool isMultiLine = size * 3 >= rightMargin_;
@@ -495,7 +661,7 @@ void StyledStreamWriter::writeValue(const Value& value) {
     pushValue(valueToString(value.asLargestUInt()));
     break;
   case realValue:
-    pushValue(valueToString(value.asDouble()));
+    pushValue(realToString(value));
     break;
   case stringValue:
     pushValue(valueToQuotedString(value.asCString()));
@@ -753,7 +919,7 @@ void BuiltStyledStreamWriter::writeValue(Value const& value) {
     pushValue(valueToString(value.asLargestUInt()));
     break;
   case realValue:
-    pushValue(valueToString(value.asDouble()));
+    pushValue(realToString(value));
     break;
   case stringValue:
     pushValue(valueToQuotedString(value.asCString()));
@@ -16,11 +16,29 @@
  */
 
 #include "mainwindow.h"
+#include "profiledatabase.h"
 #include <QApplication>
 #include <iostream>
 
 int main(int argc, char *argv[])
 {
+    // Convert between a settings file and a profile database, without the
+    // window:
+    //   OSVR-CPI --import-profiles osvr_user_settings.json osvr_user_profiles.db
+    //   OSVR-CPI --export-profiles osvr_user_profiles.db osvr_user_settings.json
+    if (argc == 4 && (strcmp(argv[1], "--import-profiles") == 0 || strcmp(argv[1], "--export-profiles") == 0)) {
+        std::string error;
+        bool done = strcmp(argv[1], "--import-profiles") == 0
+            ? ProfileDatabase::importSettings(argv[2], argv[3], &error)
+            : ProfileDatabase::exportSettings(argv[2], argv[3], &error);
+        if (!done) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << argv[3] << std::endl;
+        return 0;
+    }
+
     bool verbose = false;
     for(int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
@@ -25,6 +25,7 @@
 
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonArray>
@@ -126,6 +127,12 @@ MainWindow::MainWindow(bool verbose, QWidget* parent) :
     if (m_verbose) {
         qInfo() << "Using config file: " << m_osvrUserConfigFilename;
     }
+    // Show the defaults, then refresh the form only when loading changes
+    // something
+    updateFormValues();
+    m_osvrUser.subscribe(OSVRUser::allFields, [this](const OSVRUser &, OSVRUser::FieldMask){
+        updateFormValues();
+    });
     loadConfigFile(m_osvrUserConfigFilename);
 }
 
@@ -151,20 +158,33 @@ bool MainWindow::loadConfigFile(QString filename)
         // new file just has default values
         saveConfigFile(filename);
     }else{
-        m_osvrUser.read(value);
+        // An "activeProfile" missing from the file may be in the database
+        // next to it; a profile read from there is saved into the file
+        QString database = QFileInfo(filename).absoluteDir().filePath("osvr_user_profiles.db");
+        Json::Value profile;
+        if (m_profileDatabase.open(database.toStdString()) && m_profileDatabase.activeProfile(value, profile))
+            value["profiles"].append(profile);
+        std::string problems;
+        m_profiles.read(value, &problems);
+        if (!problems.empty())
+            qWarning("%s", problems.c_str());
+        m_osvrUser = m_profiles.active();
     }
-    updateFormValues();
+    m_osvrUser.notify();
     return true;
 }
 
 void MainWindow::updateFormValues(){
+    // m_osvrUser is the store's active profile whenever the form is filled:
+    // loading and saving both pass through m_profiles
+    const OSVRUserDerived &derived = m_profiles.activeDerived();
     if ("Male" == m_osvrUser.gender())
         ui->gender->setCurrentIndex(0);
     else
         ui->gender->setCurrentIndex(1);
-    ui->standingHeight->setText(QString::number(m_osvrUser.standingEyeHeight()));
-    ui->seatedHeight->setText(QString::number(m_osvrUser.seatedEyeHeight()));
-    ui->ipd->setText(QString::number(m_osvrUser.pupilDistance(OS)+m_osvrUser.pupilDistance(OD)));
+    ui->standingHeight->setText(QString::number(derived.eyeHeight[Standing]));
+    ui->seatedHeight->setText(QString::number(derived.eyeHeight[Seated]));
+    ui->ipd->setText(QString::number(derived.ipd));
 
     ui->dOsSpherical->setText(QString::number(m_osvrUser.spherical(OS)));
     ui->dOsCylindrical->setText(QString::number(m_osvrUser.cylindrical(OS)));
@@ -243,7 +263,8 @@ void MainWindow::saveConfigFile(QString filename)
     strcpy( cstr, fname.c_str() );
 
     Json::Value ooo;
-    m_osvrUser.write(ooo);
+    m_profiles.setActive(m_osvrUser);
+    m_profiles.write(ooo);
 
     std::ofstream out_file;
     out_file.open(cstr);
@@ -22,6 +22,8 @@
 #include <QSerialPort>
 
 #include "osvruser.h"
+#include "profiledatabase.h"
+#include "userprofilestore.h"
 
 namespace Ui {
 class MainWindow;
@@ -79,6 +81,10 @@ private:
     bool m_verbose=false;
     QString m_osvrUserConfigFilename;
     OSVRUser m_osvrUser;
+    // Every profile of the settings file; the form edits the active one
+    UserProfileStore m_profiles;
+    // Next to the settings file, for an "activeProfile" the file lacks
+    ProfileDatabase m_profileDatabase;
 };
 
 #endif // MAINWINDOW_H
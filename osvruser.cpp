@@ -16,18 +16,360 @@
  */
 
 #include <string>
+#include <cstring>
+#include <stdint.h>
 #include "osvruser.h"
 
+// The field table. A friend of OSVRUser, so that it may name the private
+// members the fields live in.
+struct OSVRUserFields
+{
+    // Accessors of one member, from a user or a const user
+    template <typename T, T OSVRUser::*Member>
+    struct Top {
+        template <typename User>
+        static auto of(User &user) -> decltype((user.*Member)){
+            return user.*Member;
+        }
+    };
+
+    template <typename T, eyeData OSVRUser::*Side, T eyeData::*Member>
+    struct Eye {
+        template <typename User>
+        static auto of(User &user) -> decltype(((user.*Side).*Member)){
+            return (user.*Side).*Member;
+        }
+    };
+
+    template <eyeData OSVRUser::*Side, double eyeCorrection::*Member>
+    struct Correction {
+        template <typename User>
+        static auto of(User &user) -> decltype(((user.*Side).correction.*Member)){
+            return (user.*Side).correction.*Member;
+        }
+    };
+
+    template <double OSVRUser::anthro::*Member>
+    struct Anthropometric {
+        template <typename User>
+        static auto of(User &user) -> decltype((user.mAnthropometric.*Member)){
+            return user.mAnthropometric.*Member;
+        }
+    };
+
+    template <typename Access>
+    static constexpr OSVRUserField textField(const char *path, const char *defaultText){
+        return {path, OSVRUserField::Text, 0, defaultText,
+                {&Access::template of<OSVRUser>, &Access::template of<const OSVRUser>},
+                {nullptr, nullptr}, {nullptr, nullptr}};
+    }
+
+    template <typename Access>
+    static constexpr OSVRUserField booleanField(const char *path, bool defaultBoolean){
+        return {path, OSVRUserField::Boolean, defaultBoolean ? 1.0 : 0.0, nullptr,
+                {nullptr, nullptr},
+                {&Access::template of<OSVRUser>, &Access::template of<const OSVRUser>},
+                {nullptr, nullptr}};
+    }
+
+    template <typename Access>
+    static constexpr OSVRUserField numberField(const char *path, double defaultNumber){
+        return {path, OSVRUserField::Number, defaultNumber, nullptr,
+                {nullptr, nullptr}, {nullptr, nullptr},
+                {&Access::template of<OSVRUser>, &Access::template of<const OSVRUser>}};
+    }
+
+    // Where each field is in the table, and so its bit in FieldMask: the
+    // gender, then the fields of each eye in this order, then the
+    // anthropometric ones.
+    enum EyeField {PupilDistance, Dominant, Spherical, Cylindrical, Axis, AddNear, eyeFieldCount};
+    enum AnthropometricField {StandingEyeHeight, SeatedEyeHeight, EyeToNeck, anthropometricFieldCount};
+    static constexpr size_t gender = 0;
+    static constexpr size_t leftEye = 1;
+    static constexpr size_t rightEye = leftEye + eyeFieldCount;
+    static constexpr size_t anthropometric = rightEye + eyeFieldCount;
+    static constexpr size_t count = anthropometric + anthropometricFieldCount;
+
+    static size_t eyeField(eyeSide eyeBall, EyeField field){
+        return (eyeBall == OS ? leftEye : rightEye) + field;
+    }
+
+    static const OSVRUserField table[count];
+};
+
+const OSVRUserField OSVRUserFields::table[OSVRUserFields::count] = {
+    textField<Top<string, &OSVRUser::mGender>>(
+        "/personalSettings/gender", "male"),
+
+    numberField<Eye<double, &OSVRUser::mLeft, &eyeData::pupilDistance>>(
+        "/personalSettings/eyes/left/pupilDistance", 32.5),
+    booleanField<Eye<bool, &OSVRUser::mLeft, &eyeData::dominant>>(
+        "/personalSettings/eyes/left/dominant", true),
+    numberField<Correction<&OSVRUser::mLeft, &eyeCorrection::spherical>>(
+        "/personalSettings/eyes/left/correction/distance/spherical", 0),
+    numberField<Correction<&OSVRUser::mLeft, &eyeCorrection::cylindrical>>(
+        "/personalSettings/eyes/left/correction/distance/cylindrical", 0),
+    numberField<Correction<&OSVRUser::mLeft, &eyeCorrection::axis>>(
+        "/personalSettings/eyes/left/correction/distance/axis", 0),
+    numberField<Eye<double, &OSVRUser::mLeft, &eyeData::addNear>>(
+        "/personalSettings/eyes/left/correction/addNear/spherical", 0),
+
+    numberField<Eye<double, &OSVRUser::mRight, &eyeData::pupilDistance>>(
+        "/personalSettings/eyes/right/pupilDistance", 32.5),
+    booleanField<Eye<bool, &OSVRUser::mRight, &eyeData::dominant>>(
+        "/personalSettings/eyes/right/dominant", false),
+    numberField<Correction<&OSVRUser::mRight, &eyeCorrection::spherical>>(
+        "/personalSettings/eyes/right/correction/distance/spherical", 0),
+    numberField<Correction<&OSVRUser::mRight, &eyeCorrection::cylindrical>>(
+        "/personalSettings/eyes/right/correction/distance/cylindrical", 0),
+    numberField<Correction<&OSVRUser::mRight, &eyeCorrection::axis>>(
+        "/personalSettings/eyes/right/correction/distance/axis", 0),
+    numberField<Eye<double, &OSVRUser::mRight, &eyeData::addNear>>(
+        "/personalSettings/eyes/right/correction/addNear/spherical", 0),
+
+    numberField<Anthropometric<&OSVRUser::anthro::standingEyeHeight>>(
+        "/personalSettings/anthropometric/standingEyeHeight", 160),
+    numberField<Anthropometric<&OSVRUser::anthro::seatedEyeHeight>>(
+        "/personalSettings/anthropometric/seatedEyeHeight", 106),
+    numberField<Anthropometric<&OSVRUser::anthro::eyeToNeck>>(
+        "/personalSettings/anthropometric/eyeToNeck", 20.32),
+};
+
+static_assert(OSVRUserFields::count <= 32, "one bit per field in OSVRUser::FieldMask");
+const OSVRUser::FieldMask OSVRUser::allFields = (OSVRUser::FieldMask(1) << OSVRUserFields::count) - 1;
+
+namespace {
+
+// The field paths compiled once, with pooled names: as a set for reading
+// every field in one walk of the tree, and one by one for creating them
+// when writing.
+struct CompiledFields
+{
+    CompiledFields(){
+        for (size_t i = 0; i < OSVRUserFields::count; ++i){
+            Json::CompiledPath path(OSVRUserFields::table[i].path, true);
+            set.add(path);
+            paths.push_back(path);
+        }
+    }
+
+    Json::CompiledPathSet set;
+    vector<Json::CompiledPath> paths;
+};
+
+const CompiledFields &compiledFields(){
+    static const CompiledFields fields;
+    return fields;
+}
+
+void setDefault(const OSVRUserField &field, OSVRUser &user){
+    switch (field.type){
+        case OSVRUserField::Text:
+            field.text.ref(user) = field.defaultText;
+            break;
+        case OSVRUserField::Boolean:
+            field.boolean.ref(user) = field.defaultNumber != 0;
+            break;
+        case OSVRUserField::Number:
+            field.number.ref(user) = field.defaultNumber;
+    }
+}
+
+bool sameValue(const OSVRUserField &field, const OSVRUser &a, const OSVRUser &b){
+    switch (field.type){
+        case OSVRUserField::Text:
+            return field.text.cref(a) == field.text.cref(b);
+        case OSVRUserField::Boolean:
+            return field.boolean.cref(a) == field.boolean.cref(b);
+        case OSVRUserField::Number:
+        default:{
+            // NaN is no change from NaN
+            double x = field.number.cref(a), y = field.number.cref(b);
+            return x == y || (x != x && y != y);
+            }
+    }
+}
+
+void copyValue(const OSVRUserField &field, const OSVRUser &from, OSVRUser &to){
+    switch (field.type){
+        case OSVRUserField::Text:
+            field.text.ref(to) = field.text.cref(from);
+            break;
+        case OSVRUserField::Boolean:
+            field.boolean.ref(to) = field.boolean.cref(from);
+            break;
+        case OSVRUserField::Number:
+            field.number.ref(to) = field.number.cref(from);
+    }
+}
+
+const char *schemaType(OSVRUserField::Type type){
+    switch (type){
+        case OSVRUserField::Text:
+            return "string";
+        case OSVRUserField::Boolean:
+            return "boolean";
+        case OSVRUserField::Number:
+        default:
+            return "number";
+    }
+}
+
+// The schema that a "$ref": "#/definitions/..." stands for, or the node
+// itself.
+const Json::Value &dereference(const Json::Value &schema, const Json::Value &node){
+    if (!node.isObject() || !node.isMember("$ref"))
+        return node;
+    const Json::Value *target = Json::CompiledPath(node["$ref"].asString().substr(1)).resolve(schema);
+    return target ? *target : Json::Value::null;
+}
+
+// The schema of member name of node, looking into "allOf" as well.
+const Json::Value *propertySchema(const Json::Value &schema, const Json::Value &node, const string &name){
+    const Json::Value &object = dereference(schema, node);
+    if (!object.isObject())
+        return nullptr;
+    const Json::Value &properties = object["properties"];
+    if (properties.isObject() && properties.isMember(name))
+        return &dereference(schema, properties[name]);
+    const Json::Value &allOf = object["allOf"];
+    for (Json::ArrayIndex i = 0; allOf.isArray() && i < allOf.size(); ++i){
+        if (const Json::Value *found = propertySchema(schema, allOf[i], name))
+            return found;
+    }
+    return nullptr;
+}
+
+// Field table signature for serialize(): FNV-1a over paths and types.
+uint32_t tableSignature(){
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        for (const char *c = field.path; *c; ++c)
+            hash = (hash ^ uint8_t(*c)) * 16777619u;
+        hash = (hash ^ uint8_t(field.type)) * 16777619u;
+    }
+    return hash;
+}
+
+void append(string &out, const void *data, size_t size){
+    out.append(static_cast<const char *>(data), size);
+}
+
+bool take(const string &in, size_t &offset, void *data, size_t size){
+    if (in.size() - offset < size)
+        return false;
+    memcpy(data, in.data() + offset, size);
+    offset += size;
+    return true;
+}
+
+}
+
+const OSVRUserField *OSVRUser::fields(){
+    return OSVRUserFields::table;
+}
+
+size_t OSVRUser::fieldCount(){
+    return OSVRUserFields::count;
+}
+
 OSVRUser::OSVRUser()
+    : mGeneration(0), mChanged(0), mNextSubscription(1)
+{
+    for (size_t i = 0; i < OSVRUserFields::count; ++i)
+        setDefault(OSVRUserFields::table[i], *this);
+}
+
+OSVRUser::OSVRUser(const OSVRUser &other)
+    : mGender(other.mGender), mLeft(other.mLeft), mRight(other.mRight),
+      mAnthropometric(other.mAnthropometric), mGeneration(other.mGeneration),
+      mChanged(0), mNextSubscription(1)
+{
+}
+
+OSVRUser &OSVRUser::operator=(const OSVRUser &other)
+{
+    if (this == &other)
+        return *this;
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        if (!sameValue(field, *this, other)){
+            copyValue(field, other, *this);
+            changed(i);
+        }
+    }
+    return *this;
+}
+
+OSVRUser::FieldMask OSVRUser::fieldMask(const string &path){
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        if (path == OSVRUserFields::table[i].path)
+            return FieldMask(1) << i;
+    }
+    return 0;
+}
+
+uint64_t OSVRUser::generation() const{
+    return mGeneration;
+}
+
+OSVRUser::FieldMask OSVRUser::changedFields() const{
+    return mChanged;
+}
+
+int OSVRUser::subscribe(FieldMask interest, const Observer &observer)
 {
-    mGender = "male";
-	setEye(OS, true, 32.5, 0.0, 0.0, 0.0, 0.0);
-	setEye(OD, false, 32.5, 0.0, 0.0, 0.0, 0.0);
-//    setEye(&mLeft,"true",32.5,0.5,-1,80,2.5);
-//  setEye(&mRight,"false",32.5,-3.25,-.25,130,0.5);
-    mAnthropometric.standingEyeHeight = 160;
-    mAnthropometric.seatedEyeHeight = 106;
-    mAnthropometric.eyeToNeck = 20.32;
+    Subscription subscription = {mNextSubscription++, interest, observer};
+    mSubscriptions.push_back(subscription);
+    return subscription.id;
+}
+
+void OSVRUser::unsubscribe(int id)
+{
+    for (size_t i = 0; i < mSubscriptions.size(); ++i){
+        if (mSubscriptions[i].id == id){
+            mSubscriptions.erase(mSubscriptions.begin() + i);
+            return;
+        }
+    }
+}
+
+void OSVRUser::notify()
+{
+    FieldMask changes = mChanged;
+    mChanged = 0;
+    if (!changes)
+        return;
+    // Observers may subscribe or unsubscribe while being told
+    vector<Subscription> subscriptions(mSubscriptions);
+    for (size_t i = 0; i < subscriptions.size(); ++i){
+        if (subscriptions[i].interest & changes)
+            subscriptions[i].observer(*this, subscriptions[i].interest & changes);
+    }
+}
+
+template <typename T>
+void OSVRUser::assign(size_t field, T &member, const T &value)
+{
+    if (member == value)
+        return;
+    member = value;
+    changed(field);
+}
+
+void OSVRUser::changed(size_t field)
+{
+    mChanged |= FieldMask(1) << field;
+    ++mGeneration;
+}
+
+eyeData &OSVRUser::eye(eyeSide eyeBall){
+    return eyeBall == OS ? mLeft : mRight;
+}
+
+const eyeData &OSVRUser::eye(eyeSide eyeBall) const{
+    return eyeBall == OS ? mLeft : mRight;
 }
 
 void OSVRUser::setEye(eyeSide eyeBall,
@@ -38,25 +380,21 @@ void OSVRUser::setEye(eyeSide eyeBall,
             double dAxis,
             double addNear){
 
-    eyeData *eD;
-
-    if (eyeBall==OD)
-        eD = &mRight;
-    else
-        eD = &mLeft;
-    eD->dominant = dominant;
-    eD->pupilDistance = pupilDistance;
-    eD->correction.spherical = dSpherical;
-    eD->correction.cylindrical = dCylindrical;
-    eD->correction.axis = dAxis;
-    eD->addNear = addNear;
+    typedef OSVRUserFields F;
+    eyeData *eD = &eye(eyeBall);
+    assign(F::eyeField(eyeBall, F::Dominant), eD->dominant, dominant);
+    assign(F::eyeField(eyeBall, F::PupilDistance), eD->pupilDistance, pupilDistance);
+    assign(F::eyeField(eyeBall, F::Spherical), eD->correction.spherical, dSpherical);
+    assign(F::eyeField(eyeBall, F::Cylindrical), eD->correction.cylindrical, dCylindrical);
+    assign(F::eyeField(eyeBall, F::Axis), eD->correction.axis, dAxis);
+    assign(F::eyeField(eyeBall, F::AddNear), eD->addNear, addNear);
 }
 
 string OSVRUser::gender() const{
     return mGender;
 }
 void OSVRUser::setGender(const string &gender){
-    mGender = gender;
+    assign(OSVRUserFields::gender, mGender, gender);
 }
 
 double OSVRUser::eyeToNeck() const{
@@ -64,7 +402,8 @@ double OSVRUser::eyeToNeck() const{
 }
 
 void OSVRUser::setEyeToNeck(double eyeToNeck){
-    mAnthropometric.eyeToNeck = eyeToNeck;
+    assign(OSVRUserFields::anthropometric + OSVRUserFields::EyeToNeck,
+           mAnthropometric.eyeToNeck, eyeToNeck);
 }
 
 double OSVRUser::standingEyeHeight() const{
@@ -72,7 +411,8 @@ double OSVRUser::standingEyeHeight() const{
 }
 
 void OSVRUser::setStandingEyeHeight(double standingHeight){
-    mAnthropometric.standingEyeHeight = standingHeight;
+    assign(OSVRUserFields::anthropometric + OSVRUserFields::StandingEyeHeight,
+           mAnthropometric.standingEyeHeight, standingHeight);
 }
 
 double OSVRUser::seatedEyeHeight() const{
@@ -80,219 +420,229 @@ double OSVRUser::seatedEyeHeight() const{
 }
 
 void OSVRUser::setSeatedEyeHeight(double seatedHeight){
-    mAnthropometric.seatedEyeHeight = seatedHeight;
+    assign(OSVRUserFields::anthropometric + OSVRUserFields::SeatedEyeHeight,
+           mAnthropometric.seatedEyeHeight, seatedHeight);
 }
 
 bool OSVRUser::dominant(eyeSide eyeBall) const{
-    if (eyeBall==OS)
-        return mLeft.dominant;
-    else
-        return mRight.dominant;
+    return eye(eyeBall).dominant;
 }
 void OSVRUser::setDominant(eyeSide eyeBall)
 {
-    switch (eyeBall){
-        case OS:{
-            mLeft.dominant = true;
-            mRight.dominant = false;
-            }
-            break;
-        case OD:{
-            mLeft.dominant = false;
-            mRight.dominant = true;
-            }
-            break;
-    }
+    assign(OSVRUserFields::eyeField(OS, OSVRUserFields::Dominant), mLeft.dominant, eyeBall == OS);
+    assign(OSVRUserFields::eyeField(OD, OSVRUserFields::Dominant), mRight.dominant, eyeBall == OD);
 }
 
 double OSVRUser::pupilDistance(eyeSide eyeBall) const{
-    switch (eyeBall){
-        case OS:
-            return mLeft.pupilDistance;
-            break;
-        case OD:
-		default:
-            return mRight.pupilDistance;
-    }
+    return eye(eyeBall).pupilDistance;
 }
 
 void OSVRUser::setPupilDistance(eyeSide eyeBall, double ipd)
 {
-    switch (eyeBall){
-        case OS:
-            mLeft.pupilDistance = ipd;
-            break;
-        case OD:
-            mRight.pupilDistance = ipd;
-    }
+    assign(OSVRUserFields::eyeField(eyeBall, OSVRUserFields::PupilDistance),
+           eye(eyeBall).pupilDistance, ipd);
 }
 
 double OSVRUser::spherical(eyeSide eyeBall) const{
-    switch (eyeBall){
-        case OS:
-            return mLeft.correction.spherical;
-            break;
-        case OD:
-		default:
-			return mRight.correction.spherical;
-    }
+    return eye(eyeBall).correction.spherical;
 }
 
 void OSVRUser::setSpherical(eyeSide eyeBall, double spherical)
 {
-    switch (eyeBall){
-        case OS:
-            mLeft.correction.spherical = spherical;
-            break;
-        case OD:
-            mRight.correction.spherical = spherical;
-    }
+    assign(OSVRUserFields::eyeField(eyeBall, OSVRUserFields::Spherical),
+           eye(eyeBall).correction.spherical, spherical);
 }
 
 double OSVRUser::cylindrical(eyeSide eyeBall) const{
-    switch (eyeBall){
-        case OS:
-            return mLeft.correction.cylindrical;
-            break;
-        case OD:
-		default:
-			return mRight.correction.cylindrical;
-    }
+    return eye(eyeBall).correction.cylindrical;
 }
 
 void OSVRUser::setCylindrical(eyeSide eyeBall, double cylindrical)
 {
-    switch (eyeBall){
-        case OS:
-            mLeft.correction.cylindrical = cylindrical;
-            break;
-        case OD:
-            mRight.correction.cylindrical = cylindrical;
-    }
+    assign(OSVRUserFields::eyeField(eyeBall, OSVRUserFields::Cylindrical),
+           eye(eyeBall).correction.cylindrical, cylindrical);
 }
 
 double OSVRUser::axis(eyeSide eyeBall) const{
-    switch (eyeBall){
-        case OS:
-            return mLeft.correction.axis;
-            break;
-        case OD:
-		default:
-			return mRight.correction.axis;
-    }
+    return eye(eyeBall).correction.axis;
 }
 
 void OSVRUser::setAxis(eyeSide eyeBall, double axis)
 {
-    switch (eyeBall){
-        case OS:
-            mLeft.correction.axis = axis;
-            break;
-        case OD:
-            mRight.correction.axis = axis;
-    }
+    assign(OSVRUserFields::eyeField(eyeBall, OSVRUserFields::Axis),
+           eye(eyeBall).correction.axis, axis);
 }
 
 double OSVRUser::addNear(eyeSide eyeBall) const{
-    switch (eyeBall){
-        case OS:
-            return mLeft.addNear;
-            break;
-        case OD:
-		default:
-			return mRight.addNear;
-    }
+    return eye(eyeBall).addNear;
 }
 
 void OSVRUser::setAddNear(eyeSide eyeBall, double addNear)
 {
-    switch (eyeBall){
-        case OS:
-            mLeft.addNear = addNear;
-            break;
-        case OD:
-            mRight.addNear = addNear;
-    }
+    assign(OSVRUserFields::eyeField(eyeBall, OSVRUserFields::AddNear),
+           eye(eyeBall).addNear, addNear);
 }
 
-void OSVRUser::readPersonal(const Json::Value qq){
-    string gender = qq["gender"].asString();
-
-    if (gender == "Male")
-        mGender = "Male";
-    else
-        mGender = "Female";
-
-    Json::Value anthro=qq["anthropometric"];
-    mAnthropometric.standingEyeHeight = anthro["standingEyeHeight"].asDouble();
-    mAnthropometric.seatedEyeHeight = anthro["seatedEyeHeight"].asDouble();
-    mAnthropometric.eyeToNeck = anthro["eyeToNeck"].asDouble();
+void OSVRUser::read(const Json::Value &json)
+{
+    // Read into a copy, then assign: only the fields that differ count as
+    // changed.
+    OSVRUser next(*this);
+    vector<const Json::Value *> nodes;
+    compiledFields().set.resolve(json, nodes);
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        const Json::Value *node = nodes[i];
+        if (!node || node->isNull()){
+            setDefault(field, next);
+            continue;
+        }
+        switch (field.type){
+            case OSVRUserField::Text:
+                field.text.ref(next) = node->asString();
+                break;
+            case OSVRUserField::Boolean:
+                field.boolean.ref(next) = node->asBool();
+                break;
+            case OSVRUserField::Number:
+                field.number.ref(next) = node->asDouble();
+        }
+    }
 
-    Json::Value eye;
-    eye = qq["eyes"];
-    readEye(&mLeft,eye["left"]);
-    readEye(&mRight,eye["right"]);
+    if (next.mGender != "Male")
+        next.mGender = "Female";
+    *this = next;
 }
 
-void OSVRUser::readEye(eyeData *eD, const Json::Value qq){
-
-    eD->pupilDistance = qq["pupilDistance"].asDouble();
-    eD->dominant = qq["dominant"].asBool();
-
-    Json::Value correction;
-    correction = qq["correction"];
-
-    Json::Value distance = correction["distance"];
-    eD->correction.spherical = distance["spherical"].asDouble();
-    eD->correction.cylindrical = distance["cylindrical"].asDouble();
-    eD->correction.axis = distance["axis"].asDouble();
-
-    Json::Value addNear = correction["addNear"];
-    eD->addNear = addNear["spherical"].asDouble();
+void OSVRUser::write(Json::Value &json) const
+{
+    json["personalSettings"] = Json::Value(Json::objectValue);
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        Json::Value &node = compiledFields().paths[i].make(json);
+        switch (field.type){
+            case OSVRUserField::Text:
+                node = field.text.cref(*this);
+                break;
+            case OSVRUserField::Boolean:
+                node = field.boolean.cref(*this);
+                break;
+            case OSVRUserField::Number:
+                node = field.number.cref(*this);
+        }
+    }
 }
 
-void OSVRUser::read(const Json::Value json)
+vector<const OSVRUserField *> OSVRUser::diff(const OSVRUser &other) const
 {
-    readPersonal(json["personalSettings"]);
+    vector<const OSVRUserField *> changed;
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        if (!sameValue(field, *this, other))
+            changed.push_back(&field);
+    }
+    return changed;
 }
 
-void OSVRUser::write(Json::Value &json) const
+string OSVRUser::serialize() const
 {
-    Json::Value oo;
-    writePersonal(oo);
-    json["personalSettings"] = oo;
+    static const uint32_t signature = tableSignature();
+    string out;
+    append(out, &signature, sizeof(signature));
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        switch (field.type){
+            case OSVRUserField::Text:{
+                const string &text = field.text.cref(*this);
+                uint32_t size = uint32_t(text.size());
+                append(out, &size, sizeof(size));
+                out += text;
+                }
+                break;
+            case OSVRUserField::Boolean:{
+                uint8_t value = field.boolean.cref(*this);
+                append(out, &value, sizeof(value));
+                }
+                break;
+            case OSVRUserField::Number:
+                append(out, &field.number.cref(*this), sizeof(double));
+        }
+    }
+    return out;
 }
 
-void OSVRUser::writePersonal(Json::Value &personalSettingsJson) const
+bool OSVRUser::deserialize(const string &data)
 {
-    Json::Value anthropometricJson;
-    anthropometricJson["eyeToNeck"] = mAnthropometric.eyeToNeck;
-    anthropometricJson["seatedEyeHeight"] = mAnthropometric.seatedEyeHeight;
-    anthropometricJson["standingEyeHeight"] = mAnthropometric.standingEyeHeight;
-    personalSettingsJson["anthropometric"] = anthropometricJson;
-
-    Json::Value eyesJson, od,os;
-    writeEye(mLeft,os);
-    eyesJson["left"] = os;
-    writeEye(mRight,od);
-    eyesJson["right"] = od;
-    personalSettingsJson["gender"] = mGender;
-    personalSettingsJson["eyes"] = eyesJson;
-}
-
-void OSVRUser::writeEye(eyeData e,Json::Value &eyeJson) const
+    static const uint32_t expected = tableSignature();
+    size_t offset = 0;
+    uint32_t signature;
+    if (!take(data, offset, &signature, sizeof(signature)) || signature != expected)
+        return false;
+
+    OSVRUser user;
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        switch (field.type){
+            case OSVRUserField::Text:{
+                uint32_t size;
+                if (!take(data, offset, &size, sizeof(size)) || data.size() - offset < size)
+                    return false;
+                field.text.ref(user).assign(data, offset, size);
+                offset += size;
+                }
+                break;
+            case OSVRUserField::Boolean:{
+                uint8_t value;
+                if (!take(data, offset, &value, sizeof(value)))
+                    return false;
+                field.boolean.ref(user) = value != 0;
+                }
+                break;
+            case OSVRUserField::Number:
+                if (!take(data, offset, &field.number.ref(user), sizeof(double)))
+                    return false;
+        }
+    }
+    if (offset != data.size())
+        return false;
+    *this = user;
+    return true;
+}
+
+bool OSVRUser::checkSchema(const Json::Value &schema, string *errors)
 {
-    eyeJson["dominant"] = e.dominant;
-    eyeJson["pupilDistance"] = e.pupilDistance;
-
-    Json::Value distance;
-    distance["axis"] = e.correction.axis;
-    distance["cylindrical"] = e.correction.cylindrical;
-    distance["spherical"] = e.correction.spherical;
-
-    Json::Value correction,near;
-    near["spherical"] = e.addNear;
-    correction["addNear"] = near;
-    correction["distance"] = distance;
-    eyeJson["correction"] = correction;
- }
+    bool good = true;
+    for (size_t i = 0; i < OSVRUserFields::count; ++i){
+        const OSVRUserField &field = OSVRUserFields::table[i];
+        const Json::Value *node = &schema;
+        string path = field.path;
+        for (size_t begin = 1; node && begin <= path.size(); ){
+            size_t end = path.find('/', begin);
+            if (end == string::npos)
+                end = path.size();
+            node = propertySchema(schema, *node, path.substr(begin, end - begin));
+            begin = end + 1;
+        }
+
+        string problem;
+        if (!node)
+            problem = "is not in the schema";
+        else if ((*node)["type"].asString() != schemaType(field.type))
+            problem = "is a " + (*node)["type"].asString() + " in the schema";
+        else if (!node->isMember("default"))
+            problem = "has no default in the schema";
+        else{
+            const Json::Value &schemaDefault = (*node)["default"];
+            if (field.type == OSVRUserField::Text
+                    ? schemaDefault.asString() != field.defaultText
+                    : schemaDefault.asDouble() != field.defaultNumber)
+                problem = "has another default in the schema";
+        }
+        if (!problem.empty()){
+            good = false;
+            if (errors)
+                *errors += string(field.path) + " " + problem + "\n";
+        }
+    }
+    return good;
+}
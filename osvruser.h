@@ -19,27 +19,72 @@
 #define OSVRUSER_H
 
 #include "json/json.h"
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
 
 using namespace std;
 
 enum eyeSide {OS,OD};
 
+typedef struct {
+    double spherical;
+    double cylindrical;
+    double axis;
+}eyeCorrection;
+
 typedef struct {
     double   pupilDistance;
     bool dominant;
-    struct {
-        double spherical;
-        double cylindrical;
-        double axis;
-    }correction;
+    eyeCorrection correction;
     double addNear;
 }eyeData;
 
+class OSVRUser;
+
+// The member of OSVRUser that holds one field, for writing and for reading.
+template <typename T>
+struct OSVRUserMember {
+    T &(*ref)(OSVRUser &user);
+    const T &(*cref)(const OSVRUser &user);
+};
+
+// One setting of OSVRUser: where it lives in osvr_user_settings.json, its
+// type, its default and the member that holds it. OSVRUser::fields() lists
+// them all, in the order of user_schema.json; read(), write(), diff() and
+// serialize() are driven by that table alone.
+struct OSVRUserField {
+    enum Type {Text, Boolean, Number};
+
+    // JSON Pointer from the document root, e.g. "/personalSettings/gender"
+    const char *path;
+    Type type;
+    // Default of Boolean (0 or 1) and Number fields
+    double defaultNumber;
+    // Default of Text fields
+    const char *defaultText;
+    // The member holding the field; only the one matching type is set
+    OSVRUserMember<string> text;
+    OSVRUserMember<bool> boolean;
+    OSVRUserMember<double> number;
+};
+
 
 class OSVRUser
 {
 public:
+    // One bit per field; bit i stands for fields()[i]
+    typedef uint32_t FieldMask;
+    // Called by notify() with the fields changed since the previous one
+    typedef function<void(const OSVRUser &user, FieldMask changed)> Observer;
+
     OSVRUser();
+    // Copies the settings and the generation, not the observers.
+    OSVRUser(const OSVRUser &other);
+    // Copies the settings, counting those that differ as changes; this
+    // user keeps its observers and its own generation count.
+    OSVRUser &operator=(const OSVRUser &other);
 
     string gender() const;
     void setGender(const string &gender);
@@ -80,14 +125,61 @@ public:
     double eyeToNeck() const;
     void setEyeToNeck(double eyeToNeck);
 
-    void read(const Json::Value json);
-    void readPersonal(const Json::Value json);
-    void readEye(eyeData *e, const Json::Value json);
+    // Every setting, in schema order; fieldCount() entries
+    static const OSVRUserField *fields();
+    static size_t fieldCount();
+    // Check the field table against user_schema.json: every path must be
+    // declared there with the same type and the same default, which the
+    // schema must give. Appends one line per mismatch to errors.
+    static bool checkSchema(const Json::Value &schema, string *errors);
+    // Bit of the field at path, or 0 if there is none
+    static FieldMask fieldMask(const string &path);
+    static const FieldMask allFields;
+
+    // Count of the changes made to this user by setters, read(),
+    // deserialize() and assignment. Setting a field to the value it already
+    // has is no change.
+    uint64_t generation() const;
+    // The fields changed since the last notify()
+    FieldMask changedFields() const;
+    // Have observer told, on each notify(), about changes to the fields in
+    // interest. Returns the id to unsubscribe with.
+    int subscribe(FieldMask interest, const Observer &observer);
+    void unsubscribe(int id);
+    // Deliver the changes made since the last call as one change set, to
+    // the observers interested in any of them. Changes are not delivered as
+    // they happen, so that a read() or a form full of setters is reported
+    // once.
+    void notify();
+
+    // Settings missing from json take their default.
+    void read(const Json::Value &json);
     void write(Json::Value &json) const;
-    void writePersonal(Json::Value &personalSettingsJson) const;
-    void writeEye(eyeData e,Json::Value &eyeJson) const;
+    // The fields whose values differ between the two users
+    vector<const OSVRUserField *> diff(const OSVRUser &other) const;
+    // Compact binary form: a signature of the field table, then each value
+    // in table order (doubles in host byte order, strings length-prefixed).
+    string serialize() const;
+    // Fails, leaving this user unchanged, on data from another field table
+    // or truncated data.
+    bool deserialize(const string &data);
 
 private:
+    friend struct OSVRUserFields;
+
+    struct Subscription {
+        int id;
+        FieldMask interest;
+        Observer observer;
+    };
+
+    eyeData &eye(eyeSide eyeBall);
+    const eyeData &eye(eyeSide eyeBall) const;
+    // Set member, which holds fields()[field], to value, recording the
+    // change if it is one
+    template <typename T> void assign(size_t field, T &member, const T &value);
+    void changed(size_t field);
+
      string mGender;
      eyeData mLeft;
      eyeData mRight;
@@ -96,6 +188,11 @@ private:
         double seatedEyeHeight;
         double eyeToNeck;
      }mAnthropometric;
+
+     uint64_t mGeneration;
+     FieldMask mChanged;
+     vector<Subscription> mSubscriptions;
+     int mNextSubscription;
 };
 
 #endif // OSVRUSER_H
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "osvruserderived.h"
+
+// Metres per unit of pupilDistance and of eyeToNeck
+static const double kMillimetre = 0.001;
+static const double kCentimetre = 0.01;
+
+OSVRUserDerived::OSVRUserDerived()
+    : OSVRUserDerived(OSVRUser())
+{
+}
+
+OSVRUserDerived::OSVRUserDerived(const OSVRUser &user)
+{
+    ipd = user.pupilDistance(OS) + user.pupilDistance(OD);
+    eyeOffset[OS] = -user.pupilDistance(OS);
+    eyeOffset[OD] = user.pupilDistance(OD);
+
+    // The eyes sit eyeToNeck in front of the neck pivot
+    for (int eye = OS; eye <= OD; ++eye){
+        headToEye[eye][0] = eyeOffset[eye] * kMillimetre;
+        headToEye[eye][1] = 0;
+        headToEye[eye][2] = -user.eyeToNeck() * kCentimetre;
+    }
+
+    eyeHeight[Standing] = user.standingEyeHeight();
+    eyeHeight[Seated] = user.seatedEyeHeight();
+    dominantEye = user.dominant(OD) && !user.dominant(OS) ? OD : OS;
+}
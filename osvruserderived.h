@@ -0,0 +1,50 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVRUSERDERIVED_H
+#define OSVRUSERDERIVED_H
+
+#include "osvruser.h"
+
+enum posture {Standing, Seated};
+
+// What renderers and the plugin need from a profile, worked out once when
+// the profile changes rather than on every frame or update.
+//
+// Distances keep the units of the settings file: pupil distances in mm,
+// eye heights as entered. The head-to-eye transforms are in metres, taking
+// eyeToNeck in cm (its default, 20.32, is 8 inches). They use the OSVR
+// head frame: x to the right, y up, z backwards.
+struct OSVRUserDerived
+{
+    OSVRUserDerived();
+    explicit OSVRUserDerived(const OSVRUser &user);
+
+    // Sum of both pupil distances
+    double ipd;
+    // Lateral offset of each eye from the nose bridge, indexed by eyeSide:
+    // negative to the left
+    double eyeOffset[2];
+    // Translation from the neck pivot to each eye, indexed by eyeSide
+    double headToEye[2][3];
+    // Eye height in each posture, indexed by posture
+    double eyeHeight[2];
+    // The dominant eye
+    eyeSide dominantEye;
+};
+
+#endif // OSVRUSERDERIVED_H
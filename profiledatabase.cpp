@@ -0,0 +1,381 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "profiledatabase.h"
+#include "userprofilestore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kMagic[8] = {'O', 'S', 'V', 'R', 'P', 'D', 'B', '\0'};
+static const uint32_t kVersion = 1;
+
+static_assert(sizeof(ProfileDatabase::EyeRecord) == 48, "EyeRecord layout");
+static_assert(sizeof(ProfileDatabase::Record) == 128, "Record layout");
+static_assert(sizeof(ProfileDatabase::IndexEntry) == 12, "IndexEntry layout");
+static_assert(sizeof(ProfileDatabase::Header) == 48, "Header layout");
+
+const size_t ProfileDatabase::npos;
+
+namespace {
+
+// Bytewise, like std::string::compare
+int compareName(const char *name, size_t length, const string &other){
+    int order = memcmp(name, other.data(), std::min(length, other.size()));
+    if (order != 0)
+        return order;
+    return length < other.size() ? -1 : length > other.size() ? 1 : 0;
+}
+
+void toRecord(const OSVRUser &user, eyeSide side, ProfileDatabase::EyeRecord &eye){
+    memset(&eye, 0, sizeof(eye));
+    eye.pupilDistance = user.pupilDistance(side);
+    eye.spherical = user.spherical(side);
+    eye.cylindrical = user.cylindrical(side);
+    eye.axis = user.axis(side);
+    eye.addNear = user.addNear(side);
+    eye.dominant = user.dominant(side);
+}
+
+void fromRecord(const ProfileDatabase::EyeRecord &eye, eyeSide side, OSVRUser &user){
+    user.setEye(side, eye.dominant != 0, eye.pupilDistance, eye.spherical,
+                eye.cylindrical, eye.axis, eye.addNear);
+}
+
+size_t align8(size_t offset){
+    return (offset + 7) & ~size_t(7);
+}
+
+}
+
+ProfileDatabase::ProfileDatabase()
+    : mData(nullptr), mSize(0), mHeader(nullptr), mIndex(nullptr),
+      mRecords(nullptr), mNames(nullptr), mNamesSize(0)
+#ifdef _WIN32
+    , mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#endif
+{
+}
+
+ProfileDatabase::~ProfileDatabase()
+{
+    close();
+}
+
+bool ProfileDatabase::fail(const string &message, string *error)
+{
+    close();
+    if (error)
+        *error = message;
+    return false;
+}
+
+bool ProfileDatabase::open(const string &path, string *error)
+{
+    close();
+#ifdef _WIN32
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return fail("cannot open " + path, error);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size))
+        return fail("cannot size " + path, error);
+    mSize = size_t(size.QuadPart);
+    if (mSize >= sizeof(Header)){
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping)
+            mData = static_cast<const char *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!mData)
+            return fail("cannot map " + path, error);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return fail("cannot open " + path, error);
+    struct stat status;
+    if (fstat(fd, &status) != 0){
+        ::close(fd);
+        return fail("cannot size " + path, error);
+    }
+    mSize = size_t(status.st_size);
+    if (mSize >= sizeof(Header)){
+        void *data = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED)
+            mData = static_cast<const char *>(data);
+    }
+    ::close(fd);
+    if (mSize >= sizeof(Header) && !mData)
+        return fail("cannot map " + path, error);
+#endif
+
+    if (mSize < sizeof(Header))
+        return fail(path + " is too short for a profile database", error);
+    mHeader = reinterpret_cast<const Header *>(mData);
+    if (memcmp(mHeader->magic, kMagic, sizeof(kMagic)) != 0)
+        return fail(path + " is not a profile database", error);
+    if (mHeader->version != kVersion)
+        return fail(path + " has an unknown profile database version", error);
+
+    uint64_t count = mHeader->count;
+    if (mHeader->size != mSize
+            || mHeader->indexOffset % 4 || mHeader->recordsOffset % 8
+            || mHeader->indexOffset > mSize || (mSize - mHeader->indexOffset) / sizeof(IndexEntry) < count
+            || mHeader->recordsOffset > mSize || (mSize - mHeader->recordsOffset) / sizeof(Record) < count
+            || mHeader->namesOffset > mSize)
+        return fail(path + " is truncated or damaged", error);
+    mIndex = reinterpret_cast<const IndexEntry *>(mData + mHeader->indexOffset);
+    mRecords = reinterpret_cast<const Record *>(mData + mHeader->recordsOffset);
+    mNames = mData + mHeader->namesOffset;
+    mNamesSize = size_t(mSize - mHeader->namesOffset);
+    return true;
+}
+
+void ProfileDatabase::close()
+{
+#ifdef _WIN32
+    if (mData)
+        UnmapViewOfFile(mData);
+    if (mMapping)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if (mData)
+        munmap(const_cast<char *>(mData), mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+    mHeader = nullptr;
+    mIndex = nullptr;
+    mRecords = nullptr;
+    mNames = nullptr;
+    mNamesSize = 0;
+}
+
+bool ProfileDatabase::isOpen() const{
+    return mHeader != nullptr;
+}
+
+size_t ProfileDatabase::size() const{
+    return mHeader ? mHeader->count : 0;
+}
+
+bool ProfileDatabase::nameFits(const IndexEntry &entry) const{
+    return entry.nameOffset <= mNamesSize && entry.nameLength <= mNamesSize - entry.nameOffset;
+}
+
+int ProfileDatabase::compare(const IndexEntry &entry, const string &name) const{
+    if (!nameFits(entry))
+        return compareName("", 0, name);
+    return compareName(mNames + entry.nameOffset, entry.nameLength, name);
+}
+
+size_t ProfileDatabase::find(const string &name) const{
+    const IndexEntry *begin = mIndex;
+    const IndexEntry *end = mIndex + size();
+    const IndexEntry *found = std::lower_bound(begin, end, name,
+        [this](const IndexEntry &entry, const string &key){
+            return compare(entry, key) < 0;
+        });
+    if (found == end || compare(*found, name) != 0)
+        return npos;
+    return size_t(found - begin);
+}
+
+string ProfileDatabase::name(size_t index) const{
+    const IndexEntry &entry = mIndex[index];
+    if (!nameFits(entry))
+        return string();
+    return string(mNames + entry.nameOffset, entry.nameLength);
+}
+
+const ProfileDatabase::Record &ProfileDatabase::record(size_t index) const{
+    static const Record empty = Record();
+    uint32_t record = mIndex[index].record;
+    return record < size() ? mRecords[record] : empty;
+}
+
+OSVRUser ProfileDatabase::user(size_t index) const{
+    const Record &data = record(index);
+    OSVRUser user;
+    fromRecord(data.left, OS, user);
+    fromRecord(data.right, OD, user);
+    user.setStandingEyeHeight(data.standingEyeHeight);
+    user.setSeatedEyeHeight(data.seatedEyeHeight);
+    user.setEyeToNeck(data.eyeToNeck);
+    user.setGender(string(data.gender, strnlen(data.gender, sizeof(data.gender))));
+    return user;
+}
+
+void ProfileDatabase::load(UserProfileStore &store) const
+{
+    store.clear();
+    for (size_t index = 0; index < size(); ++index)
+        store.add(name(index), user(index));
+    if (store.size())
+        store.select(store.id(0));
+}
+
+bool ProfileDatabase::activeProfile(const Json::Value &settings, Json::Value &profile) const
+{
+    const Json::Value &active = settings["activeProfile"];
+    const Json::Value &profiles = settings["profiles"];
+    if (!active.isString() || !profiles.isArray())
+        return false;
+    string name = active.asString();
+    for (Json::ArrayIndex i = 0; i < profiles.size(); ++i){
+        if (profiles[i]["personalSettings"]["name"].asString() == name)
+            return false;
+    }
+    size_t index = find(name);
+    if (index == npos)
+        return false;
+    profile = Json::Value(Json::objectValue);
+    user(index).write(profile);
+    profile["personalSettings"]["name"] = name;
+    return true;
+}
+
+bool ProfileDatabase::write(const string &path, const UserProfileStore &store, string *error)
+{
+    size_t count = store.size();
+    vector<size_t> order(count);
+    size_t namesSize = 0;
+    for (size_t i = 0; i < count; ++i){
+        order[i] = i;
+        namesSize += store.name(i).size();
+    }
+    if (namesSize > UINT32_MAX || count > UINT32_MAX){
+        if (error)
+            *error = "too many profiles for one database";
+        return false;
+    }
+    std::sort(order.begin(), order.end(), [&store](size_t a, size_t b){
+        return store.name(a) < store.name(b);
+    });
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = uint32_t(count);
+    header.indexOffset = sizeof(Header);
+    header.recordsOffset = align8(header.indexOffset + count * sizeof(IndexEntry));
+    header.namesOffset = header.recordsOffset + count * sizeof(Record);
+    header.size = header.namesOffset + namesSize;
+
+    string data(size_t(header.size), '\0');
+    memcpy(&data[0], &header, sizeof(header));
+    IndexEntry *index = reinterpret_cast<IndexEntry *>(&data[header.indexOffset]);
+    Record *records = reinterpret_cast<Record *>(&data[header.recordsOffset]);
+    char *names = &data[0] + header.namesOffset;
+    uint32_t nameOffset = 0;
+    for (size_t i = 0; i < count; ++i){
+        // Records in name order as well, so that a scan reads the file in
+        // order
+        const string &name = store.name(order[i]);
+        index[i].nameOffset = nameOffset;
+        index[i].nameLength = uint32_t(name.size());
+        index[i].record = uint32_t(i);
+        memcpy(names + nameOffset, name.data(), name.size());
+        nameOffset += uint32_t(name.size());
+
+        OSVRUser user = store.user(order[i]);
+        Record &record = records[i];
+        toRecord(user, OS, record.left);
+        toRecord(user, OD, record.right);
+        record.standingEyeHeight = user.standingEyeHeight();
+        record.seatedEyeHeight = user.seatedEyeHeight();
+        record.eyeToNeck = user.eyeToNeck();
+        strncpy(record.gender, user.gender().c_str(), sizeof(record.gender));
+    }
+
+    // Into a file of its own, renamed over path once complete: a reader
+    // with path mapped keeps the old file rather than see it truncated
+    string temporary = path + ".tmp";
+    std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), std::streamsize(data.size()));
+    file.close();
+    if (!file){
+        std::remove(temporary.c_str());
+        if (error)
+            *error = "cannot write " + temporary;
+        return false;
+    }
+#ifdef _WIN32
+    bool renamed = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!renamed){
+        std::remove(temporary.c_str());
+        if (error)
+            *error = "cannot replace " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ProfileDatabase::importSettings(const string &settingsPath, const string &databasePath, string *error)
+{
+    std::ifstream file(settingsPath.c_str());
+    Json::CharReaderBuilder builder;
+    Json::Value settings;
+    string errors;
+    if (!Json::parseFromStream(builder, file, &settings, &errors)){
+        if (error)
+            *error = settingsPath + ": " + errors;
+        return false;
+    }
+    UserProfileStore store;
+    store.read(settings);
+    return write(databasePath, store, error);
+}
+
+bool ProfileDatabase::exportSettings(const string &databasePath, const string &settingsPath, string *error)
+{
+    ProfileDatabase database;
+    if (!database.open(databasePath, error))
+        return false;
+    UserProfileStore store;
+    database.load(store);
+    Json::Value settings;
+    store.write(settings);
+
+    std::ofstream file(settingsPath.c_str());
+    file << Json::StyledWriter().write(settings);
+    file.close();
+    if (!file){
+        if (error)
+            *error = "cannot write " + settingsPath;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PROFILEDATABASE_H
+#define PROFILEDATABASE_H
+
+#include "osvruser.h"
+#include <stdint.h>
+#include <string>
+
+class UserProfileStore;
+
+// A single file holding the profiles of many users, mapped into memory
+// instead of parsed.
+//
+// The file is laid out in host byte order:
+//   Header
+//   name index   count IndexEntry, sorted by name (bytewise)
+//   records      count Record
+//   names        the names, one after the other, without terminators
+// Looking a user up is a binary search of the index, then a copy of one
+// record. Opening the file only maps it and checks that these tables fit;
+// the entries are checked as lookups reach them, and in a damaged file an
+// entry pointing out of bounds reads as an empty name or record.
+class ProfileDatabase
+{
+public:
+    static const size_t npos = size_t(-1);
+
+    struct EyeRecord {
+        double pupilDistance;
+        double spherical;
+        double cylindrical;
+        double axis;
+        double addNear;
+        uint8_t dominant;
+        uint8_t reserved[7];
+    };
+
+    struct Record {
+        EyeRecord left;
+        EyeRecord right;
+        double standingEyeHeight;
+        double seatedEyeHeight;
+        double eyeToNeck;
+        // NUL-padded; a longer gender is cut short
+        char gender[8];
+    };
+
+    struct IndexEntry {
+        // Into the names
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t record;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint64_t indexOffset;
+        uint64_t recordsOffset;
+        uint64_t namesOffset;
+        // Of the whole file
+        uint64_t size;
+    };
+
+    ProfileDatabase();
+    ~ProfileDatabase();
+
+    // Map a database file. Fails on a missing, truncated or foreign file.
+    bool open(const string &path, string *error = nullptr);
+    void close();
+    bool isOpen() const;
+
+    size_t size() const;
+    // Index of the named profile, in name order, or npos
+    size_t find(const string &name) const;
+    string name(size_t index) const;
+    const Record &record(size_t index) const;
+    OSVRUser user(size_t index) const;
+    // Replace the profiles of store by those of the database.
+    void load(UserProfileStore &store) const;
+    // The profile the "activeProfile" of settings names, as a profile of
+    // the settings file, if settings do not hold it and the database does.
+    bool activeProfile(const Json::Value &settings, Json::Value &profile) const;
+
+    // Write every profile of store to a new database file, renamed over
+    // path once complete, so that readers with path open keep the old one.
+    static bool write(const string &path, const UserProfileStore &store, string *error = nullptr);
+    // Convert an osvr_user_settings.json, with one or many profiles, into a
+    // database, and back.
+    static bool importSettings(const string &settingsPath, const string &databasePath, string *error = nullptr);
+    static bool exportSettings(const string &databasePath, const string &settingsPath, string *error = nullptr);
+
+private:
+    ProfileDatabase(const ProfileDatabase &);
+    ProfileDatabase &operator=(const ProfileDatabase &);
+
+    bool fail(const string &message, string *error);
+    bool nameFits(const IndexEntry &entry) const;
+    int compare(const IndexEntry &entry, const string &name) const;
+
+    const char *mData;
+    size_t mSize;
+    const Header *mHeader;
+    const IndexEntry *mIndex;
+    const Record *mRecords;
+    const char *mNames;
+    size_t mNamesSize;
+#ifdef _WIN32
+    void *mFile;
+    void *mMapping;
+#endif
+};
+
+#endif // PROFILEDATABASE_H
@@ -0,0 +1,287 @@
+// Copyright 2016 OSVR and contributors.
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+/* Checks of what the extensions to this copy of jsoncpp promise. Each case
+ * reports its failed checks to stderr; the exit status is the number of
+ * failed cases. Pass a case name to run only the cases containing it.
+ */
+
+#include <json/json.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures;
+
+#define JSONTEST_CHECK(expression)                                             \
+  do {                                                                         \
+    if (!(expression)) {                                                       \
+      fprintf(stderr, "  %s:%d: %s\n", __FILE__, __LINE__, #expression);       \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+static Json::Value parse(const std::string& text, bool lazyNumbers) {
+  Json::Features features = Json::Features::all();
+  features.lazyNumbers_ = lazyNumbers;
+  Json::Reader reader(features);
+  Json::Value root;
+  JSONTEST_CHECK(reader.parse(text, root));
+  return root;
+}
+
+static std::string fastWrite(const Json::Value& value) {
+  Json::FastWriter writer;
+  writer.omitEndingLineFeed();
+  return writer.write(value);
+}
+
+// Lazy numbers
+// //////////////////////////////////////////////////////////////////
+
+/// Reals outside the RFC 8259 grammar are converted when read, so that the
+/// writers never copy them into the output.
+static void testLazyNumbersWriteValidJson() {
+  const char* text = "[1., 1e, -, 2.5e+, 01.5]";
+  std::string eager = fastWrite(parse(text, false));
+  std::string lazy = fastWrite(parse(text, true));
+  JSONTEST_CHECK(lazy == eager);
+  Json::Value reread;
+  JSONTEST_CHECK(Json::Reader(Json::Features::strictMode()).parse(lazy, reread));
+}
+
+/// Reals in the grammar keep their text.
+static void testLazyNumbersKeepTheirText() {
+  const char* text = "[0.10,-0.0,1E+2,1e-07,123.4500]";
+  JSONTEST_CHECK(fastWrite(parse(text, true)) == text);
+  Json::Value root = parse(text, true);
+  JSONTEST_CHECK(root[0].asDouble() == 0.1);
+  JSONTEST_CHECK(root[2].asDouble() == 100.0);
+}
+
+// Hash
+// //////////////////////////////////////////////////////////////////
+
+/// Trees hashed while they differed, then made equal through a reference
+/// taken before hashing, compare and hash equal.
+static void testHashSeesEditsThroughReferences() {
+  Json::Value a, b;
+  a["x"] = "same";
+  a["y"]["v"] = 1;
+  b["x"] = "same";
+  b["y"]["v"] = 2;
+  Json::Value& c = a["y"]["v"];
+  JSONTEST_CHECK(a.hash() != b.hash());
+  c = 2;
+  JSONTEST_CHECK(a == b);
+  JSONTEST_CHECK(a.compare(b) == 0);
+  JSONTEST_CHECK(a.hash() == b.hash());
+  const Json::Value& constA = a;
+  JSONTEST_CHECK(constA.hash() == b.hash());
+}
+
+/// The same through an iterator, down to the deepest first leaf.
+static void testHashSeesEditsThroughIterators() {
+  Json::Value a = parse("{\"r\":[{\"k\":[1,2,{\"z\":true}]}],\"s\":4}",
+                        false);
+  Json::Value b = a;
+  Json::Value* leaf = &a;
+  while (leaf->size())
+    leaf = &*leaf->begin();
+  Json::Value original = *leaf;
+  *leaf = "edited";
+  JSONTEST_CHECK(a.hash() != b.hash());
+  JSONTEST_CHECK(a != b);
+  *leaf = original;
+  JSONTEST_CHECK(a == b);
+  JSONTEST_CHECK(a.hash() == b.hash());
+}
+
+/// Values that compare equal hash equal, whatever their number type.
+static void testHashOfEqualValues() {
+  JSONTEST_CHECK(Json::Value(0.0).hash() == Json::Value(-0.0).hash());
+  Json::Value lazy = parse("[1.50]", true);
+  Json::Value eager = parse("[1.5]", false);
+  JSONTEST_CHECK(lazy == eager);
+  JSONTEST_CHECK(lazy.hash() == eager.hash());
+}
+
+// CompiledPath
+// //////////////////////////////////////////////////////////////////
+
+/// Paths compiled from outside input leave the Key pool as it was.
+static void testCompiledPathDoesNotPoolNames() {
+  Json::Value root;
+  size_t before = Json::Key::poolStatistics().names;
+  for (int index = 0; index < 1000; ++index) {
+    char pointer[32];
+    sprintf(pointer, "/unpooled%d/%d/-", index, index);
+    Json::CompiledPath path(pointer);
+    path.make(root);
+    JSONTEST_CHECK(path.resolve(root) == &path.make(root));
+  }
+  JSONTEST_CHECK(Json::Key::poolStatistics().names == before);
+  JSONTEST_CHECK(root.size() == 1000);
+  JSONTEST_CHECK(Json::CompiledPath("/unpooled7/7/-").resolve(root) != 0);
+}
+
+/// A pooled path finds and creates the same members as an unpooled one.
+static void testCompiledPathPoolsOnRequest() {
+  Json::Value root;
+  Json::CompiledPath pooled("/eyes/left/pupilDistance", true);
+  pooled.make(root) = 31.5;
+  size_t names = Json::Key::poolStatistics().names;
+  JSONTEST_CHECK(Json::Key("pupilDistance").c_str() ==
+                 root["eyes"]["left"].begin().memberName());
+  JSONTEST_CHECK(Json::Key::poolStatistics().names == names);
+  JSONTEST_CHECK(Json::CompiledPath("/eyes/left/pupilDistance")
+                     .resolve(root, Json::Value())
+                     .asDouble() == 31.5);
+  Json::CompiledPathSet set;
+  set.add(Json::CompiledPath("/eyes/left/pupilDistance"));
+  set.add(pooled);
+  std::vector<const Json::Value*> nodes;
+  set.resolve(root, nodes);
+  JSONTEST_CHECK(nodes.size() == 2 && nodes[0] && nodes[0] == nodes[1]);
+}
+
+// Patch
+// //////////////////////////////////////////////////////////////////
+
+/// Patches naming new members, as built from outside input, leave the Key
+/// pool as it was.
+static void testPatchDoesNotPoolNames() {
+  Json::Value root(Json::objectValue);
+  size_t before = Json::Key::poolStatistics().names;
+  for (int index = 0; index < 10000; ++index) {
+    char text[64];
+    sprintf(text, "[{\"op\":\"add\",\"path\":\"/added%d\",\"value\":%d}]",
+            index, index);
+    std::string errs;
+    JSONTEST_CHECK(Json::applyPatch(root, parse(text, false), &errs));
+  }
+  JSONTEST_CHECK(Json::Key::poolStatistics().names == before);
+  JSONTEST_CHECK(root.size() == 10000);
+  JSONTEST_CHECK(root["added9999"].asInt() == 9999);
+}
+
+/// A merge patch of a deep tree holds the path down to the change.
+static void testMergePatchOfDeepTree() {
+  Json::Value from, to;
+  Json::Value* fromNode = &from;
+  Json::Value* toNode = &to;
+  for (int depth = 0; depth < 500; ++depth) {
+    fromNode = &(*fromNode)["child"];
+    toNode = &(*toNode)["child"];
+    (*fromNode)["same"] = depth;
+    (*toNode)["same"] = depth;
+  }
+  (*toNode)["leaf"] = true;
+  Json::Value patch = Json::makeMergePatch(from, to);
+  Json::applyMergePatch(from, patch);
+  JSONTEST_CHECK(from == to);
+  JSONTEST_CHECK(!patch["child"].isMember("same"));
+  JSONTEST_CHECK(Json::makeMergePatch(to, to).empty());
+}
+
+// Snapshot
+// //////////////////////////////////////////////////////////////////
+
+/// A snapshot keeps the scalars of a tree, not their comments and offsets.
+static void testSnapshotKeepsPayloadsOnly() {
+  Json::Value root = parse("{\"name\": \"a\", // who\n"
+                           " \"count\": 3, \"big\": 4294967296,"
+                           " \"on\": true, \"none\": null}",
+                           false);
+  JSONTEST_CHECK(root["name"].hasComment(Json::commentAfterOnSameLine));
+  JSONTEST_CHECK(root["count"].getOffsetLimit() > 0);
+  Json::Snapshot snapshot(root);
+  const Json::Value& name = snapshot[Json::Key("name")].scalar();
+  JSONTEST_CHECK(name == "a" && !name.hasComment(Json::commentAfterOnSameLine));
+  JSONTEST_CHECK(snapshot[Json::Key("count")].scalar().getOffsetLimit() == 0);
+  JSONTEST_CHECK(snapshot[Json::Key("count")].scalar().type() ==
+                 Json::intValue);
+  JSONTEST_CHECK(snapshot[Json::Key("big")].scalar().type() ==
+                 Json::uintValue);
+  JSONTEST_CHECK(snapshot.toValue() == root);
+}
+
+// Side table
+// //////////////////////////////////////////////////////////////////
+
+/// Parsing with offsets on a pool locks the side table once per batch of
+/// entries, and once the trees and the pool are gone the table holds no more
+/// than an empty page more than before.
+static void testExtrasGoBackWithTheirThreads() {
+  std::string text = "[";
+  for (int index = 0; index < 2000; ++index)
+    text += index ? ",{\"id\":1,\"x\":[2.5]}" : "{\"id\":1,\"x\":[2.5]}";
+  text += "]";
+  const size_t files = 64;
+  const size_t valuesPerFile = 1 + 2000 * 4;
+  Json::Value::ExtraStatistics before = Json::Value::extraStatistics();
+  Json::Value::ExtraStatistics parsed;
+  std::thread owner([&] {
+    std::vector<Json::DocumentText> texts(files);
+    for (size_t file = 0; file < files; ++file) {
+      texts[file].begin_ = text.data();
+      texts[file].end_ = text.data() + text.size();
+    }
+    std::vector<Json::Document> documents(files);
+    std::vector<std::string> errors(files);
+    {
+      Json::WorkerPool pool(4);
+      Json::CharReaderBuilder builder;
+      JSONTEST_CHECK(Json::parseMany(pool, builder, &texts[0], files,
+                                     &documents[0], &errors[0]) == 0);
+      parsed = Json::Value::extraStatistics();
+    }
+    JSONTEST_CHECK(documents[0].root()[1999].getOffsetStart() > 0);
+  });
+  owner.join();
+  Json::Value::ExtraStatistics after = Json::Value::extraStatistics();
+  JSONTEST_CHECK(parsed.entries >= before.entries + files * valuesPerFile);
+  JSONTEST_CHECK(parsed.locks - before.locks < files * valuesPerFile / 32);
+  JSONTEST_CHECK(after.entries == before.entries);
+  JSONTEST_CHECK(after.pages <= before.pages + 1);
+}
+
+typedef void (*TestFunction)();
+
+struct Test {
+  const char* name;
+  TestFunction run;
+};
+
+static const Test tests[] = {
+  { "lazyNumbers.writeValidJson", testLazyNumbersWriteValidJson },
+  { "lazyNumbers.keepTheirText", testLazyNumbersKeepTheirText },
+  { "hash.seesEditsThroughReferences", testHashSeesEditsThroughReferences },
+  { "hash.seesEditsThroughIterators", testHashSeesEditsThroughIterators },
+  { "hash.ofEqualValues", testHashOfEqualValues },
+  { "compiledPath.doesNotPoolNames", testCompiledPathDoesNotPoolNames },
+  { "compiledPath.poolsOnRequest", testCompiledPathPoolsOnRequest },
+  { "patch.doesNotPoolNames", testPatchDoesNotPoolNames },
+  { "mergePatch.ofDeepTree", testMergePatchOfDeepTree },
+  { "snapshot.keepsPayloadsOnly", testSnapshotKeepsPayloadsOnly },
+  { "extras.goBackWithTheirThreads", testExtrasGoBackWithTheirThreads },
+};
+
+int main(int argc, char* argv[]) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  int failed = 0;
+  for (size_t index = 0; index < sizeof(tests) / sizeof(tests[0]); ++index) {
+    const Test& test = tests[index];
+    if (std::string(test.name).find(filter) == std::string::npos)
+      continue;
+    int before = failures;
+    test.run();
+    bool passed = failures == before;
+    failed += !passed;
+    fprintf(stderr, "%-40s %s\n", test.name, passed ? "ok" : "FAILED");
+  }
+  return failed;
+}
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "userprofilestore.h"
+
+static const Json::Key kProfiles("profiles");
+static const Json::Key kActiveProfile("activeProfile");
+static const Json::Key kPersonalSettings("personalSettings");
+static const Json::Key kName("name");
+
+const size_t UserProfileStore::npos;
+const UserProfileStore::Id UserProfileStore::noId;
+
+UserProfileStore::UserProfileStore()
+    : mColumns(OSVRUser::fieldCount()), mNextId(1), mActiveIndex(npos)
+{
+}
+
+size_t UserProfileStore::size() const{
+    return mIds.size();
+}
+
+UserProfileStore::Id UserProfileStore::add(const string &name, const OSVRUser &user)
+{
+    size_t index = indexOf(name);
+    if (index == npos)
+        index = insert(name);
+    setUser(index, user);
+    return mIds[index];
+}
+
+size_t UserProfileStore::insert(const string &name)
+{
+    size_t index = size();
+    resize(index + 1);
+    Id &id = mIdOfName[name];
+    if (id == noId)
+        id = mNextId++;
+    mNames[index] = name;
+    mIds[index] = id;
+    mByName[name] = index;
+    mById[id] = index;
+    return index;
+}
+
+bool UserProfileStore::remove(Id id)
+{
+    size_t index = indexOf(id);
+    if (index == npos)
+        return false;
+    if (mActiveIndex == index){
+        activate(npos, OSVRUser());
+        publish();
+    }
+
+    mByName.erase(mNames[index]);
+    mById.erase(id);
+    mIdOfName.erase(mNames[index]);
+    size_t last = size() - 1;
+    if (index != last){
+        moveRow(last, index);
+        mByName[mNames[index]] = index;
+        mById[mIds[index]] = index;
+        if (mActiveIndex == last)
+            mActiveIndex = index;
+    }
+    resize(last);
+    return true;
+}
+
+void UserProfileStore::clear()
+{
+    resize(0);
+    mByName.clear();
+    mById.clear();
+    mIdOfName.clear();
+    activate(npos, OSVRUser());
+    publish();
+}
+
+size_t UserProfileStore::indexOf(Id id) const{
+    unordered_map<Id, size_t>::const_iterator found = mById.find(id);
+    return found == mById.end() ? npos : found->second;
+}
+
+size_t UserProfileStore::indexOf(const string &name) const{
+    unordered_map<string, size_t>::const_iterator found = mByName.find(name);
+    return found == mByName.end() ? npos : found->second;
+}
+
+UserProfileStore::Id UserProfileStore::id(size_t index) const{
+    return mIds[index];
+}
+
+const string &UserProfileStore::name(size_t index) const{
+    return mNames[index];
+}
+
+OSVRUser UserProfileStore::user(size_t index) const{
+    OSVRUser user;
+    load(index, user);
+    return user;
+}
+
+void UserProfileStore::setUser(size_t index, const OSVRUser &user)
+{
+    store(index, user);
+    if (index == mActiveIndex){
+        activate(index, user);
+        publish();
+    }
+}
+
+const vector<double> &UserProfileStore::numbers(size_t field) const{
+    return mColumns[field].numbers;
+}
+
+bool UserProfileStore::select(Id id)
+{
+    size_t index = indexOf(id);
+    if (index == npos)
+        return false;
+    if (index != mActiveIndex){
+        activate(index, user(index));
+        publish();
+    }
+    return true;
+}
+
+bool UserProfileStore::select(const string &name)
+{
+    size_t index = indexOf(name);
+    return index != npos && select(mIds[index]);
+}
+
+UserProfileStore::Id UserProfileStore::activeId() const{
+    return mActiveIndex == npos ? noId : mIds[mActiveIndex];
+}
+
+const OSVRUser &UserProfileStore::active() const{
+    return mActive;
+}
+
+const OSVRUserDerived &UserProfileStore::activeDerived() const{
+    return mActiveDerived;
+}
+
+void UserProfileStore::setActive(const OSVRUser &user)
+{
+    if (mActiveIndex == npos)
+        select(add(string(), user));
+    else
+        setUser(mActiveIndex, user);
+}
+
+void UserProfileStore::read(const Json::Value &json, string *problems)
+{
+    // Observers hear once, about the profile active at the end. The names
+    // keep their ids through mIdOfName.
+    resize(0);
+    mByName.clear();
+    mById.clear();
+    mActiveIndex = npos;
+    OSVRUser user;
+    const Json::Value &profiles = json[kProfiles];
+    if (profiles.isArray()){
+        for (Json::ArrayIndex i = 0; i < profiles.size(); ++i){
+            user.read(profiles[i]);
+            string name = profiles[i][kPersonalSettings][kName].asString();
+            if (indexOf(name) != npos){
+                // Named after the position, so that the new name, and so
+                // its id, is the same on every read of this file
+                string base = name.empty() ? "profile " : name + " (";
+                string end = name.empty() ? "" : ")";
+                string unique;
+                for (size_t n = i + 1; unique.empty() || indexOf(unique) != npos; ++n)
+                    unique = base + std::to_string(n) + end;
+                if (problems)
+                    *problems += "profile " + std::to_string(i + 1) + (name.empty()
+                        ? string(" is unnamed like an earlier one")
+                        : " is named \"" + name + "\" like an earlier one")
+                        + "; read as \"" + unique + "\"\n";
+                name = unique;
+            }
+            store(insert(name), user);
+        }
+    }
+    else{
+        user.read(json);
+        store(insert(json[kPersonalSettings][kName].asString()), user);
+    }
+
+    const Json::Value &activeProfile = json[kActiveProfile];
+    size_t index = activeProfile.isString() ? indexOf(activeProfile.asString()) : npos;
+    if (index == npos && size())
+        index = 0;
+    activate(index, index == npos ? OSVRUser() : this->user(index));
+    publish();
+}
+
+void UserProfileStore::write(Json::Value &json) const
+{
+    if (size() == 1){
+        user(0).write(json);
+        if (!mNames[0].empty())
+            json["personalSettings"]["name"] = mNames[0];
+        return;
+    }
+
+    Json::Value &profiles = json["profiles"] = Json::Value(Json::arrayValue);
+    for (size_t index = 0; index < size(); ++index){
+        Json::Value &profile = profiles.append(Json::Value(Json::objectValue));
+        user(index).write(profile);
+        profile["personalSettings"]["name"] = mNames[index];
+    }
+    if (mActiveIndex != npos)
+        json["activeProfile"] = mNames[mActiveIndex];
+}
+
+void UserProfileStore::resize(size_t size)
+{
+    const OSVRUserField *fields = OSVRUser::fields();
+    for (size_t i = 0; i < mColumns.size(); ++i){
+        Column &column = mColumns[i];
+        switch (fields[i].type){
+            case OSVRUserField::Text:
+                column.texts.resize(size);
+                break;
+            case OSVRUserField::Boolean:
+                column.booleans.resize(size);
+                break;
+            case OSVRUserField::Number:
+                column.numbers.resize(size);
+        }
+    }
+    mNames.resize(size);
+    mIds.resize(size);
+}
+
+void UserProfileStore::store(size_t index, const OSVRUser &user)
+{
+    const OSVRUserField *fields = OSVRUser::fields();
+    for (size_t i = 0; i < mColumns.size(); ++i){
+        const OSVRUserField &field = fields[i];
+        switch (field.type){
+            case OSVRUserField::Text:
+                mColumns[i].texts[index] = field.text.cref(user);
+                break;
+            case OSVRUserField::Boolean:
+                mColumns[i].booleans[index] = field.boolean.cref(user);
+                break;
+            case OSVRUserField::Number:
+                mColumns[i].numbers[index] = field.number.cref(user);
+        }
+    }
+}
+
+void UserProfileStore::load(size_t index, OSVRUser &user) const
+{
+    const OSVRUserField *fields = OSVRUser::fields();
+    for (size_t i = 0; i < mColumns.size(); ++i){
+        const OSVRUserField &field = fields[i];
+        switch (field.type){
+            case OSVRUserField::Text:
+                field.text.ref(user) = mColumns[i].texts[index];
+                break;
+            case OSVRUserField::Boolean:
+                field.boolean.ref(user) = mColumns[i].booleans[index] != 0;
+                break;
+            case OSVRUserField::Number:
+                field.number.ref(user) = mColumns[i].numbers[index];
+        }
+    }
+}
+
+void UserProfileStore::moveRow(size_t from, size_t to)
+{
+    const OSVRUserField *fields = OSVRUser::fields();
+    for (size_t i = 0; i < mColumns.size(); ++i){
+        Column &column = mColumns[i];
+        switch (fields[i].type){
+            case OSVRUserField::Text:
+                column.texts[to].swap(column.texts[from]);
+                break;
+            case OSVRUserField::Boolean:
+                column.booleans[to] = column.booleans[from];
+                break;
+            case OSVRUserField::Number:
+                column.numbers[to] = column.numbers[from];
+        }
+    }
+    mNames[to].swap(mNames[from]);
+    mIds[to] = mIds[from];
+}
+
+int UserProfileStore::subscribe(OSVRUser::FieldMask interest, const OSVRUser::Observer &observer)
+{
+    return mActive.subscribe(interest, observer);
+}
+
+void UserProfileStore::unsubscribe(int id)
+{
+    mActive.unsubscribe(id);
+}
+
+void UserProfileStore::activate(size_t index, const OSVRUser &user)
+{
+    mActiveIndex = index;
+    mActive = user;
+}
+
+void UserProfileStore::publish()
+{
+    if (!mActive.changedFields())
+        return;
+    mActiveDerived = OSVRUserDerived(mActive);
+    mActive.notify();
+}
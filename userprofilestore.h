@@ -0,0 +1,135 @@
+/*
+ * Copyright 2016 OSVR and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef USERPROFILESTORE_H
+#define USERPROFILESTORE_H
+
+#include "osvruser.h"
+#include "osvruserderived.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Many named profiles of the same rig, e.g. the operators of an arcade
+// station, with one of them active.
+//
+// The profiles are kept column by column: one array per field of
+// OSVRUser::fields(), indexed by profile. Scanning one setting across every
+// profile touches one array only. Profiles are found by name or by id
+// through hash indices; an id stays with its name until the profile is
+// removed, across read() too, while its index may change when another
+// profile is removed.
+//
+// Switching the active profile is a lookup, a copy of one row into the
+// active OSVRUser and the OSVRUserDerived of it; nothing is read from disk.
+class UserProfileStore
+{
+public:
+    typedef unsigned int Id;
+    static const size_t npos = size_t(-1);
+    static const Id noId = 0;
+
+    UserProfileStore();
+
+    size_t size() const;
+
+    // Add a profile, or replace the settings of the one of that name.
+    // Returns its id.
+    Id add(const string &name, const OSVRUser &user);
+    // Remove a profile. The last profile takes its index. Removing the
+    // active profile leaves none active.
+    bool remove(Id id);
+    void clear();
+
+    // Index of a profile, or npos
+    size_t indexOf(Id id) const;
+    size_t indexOf(const string &name) const;
+
+    Id id(size_t index) const;
+    const string &name(size_t index) const;
+    OSVRUser user(size_t index) const;
+    void setUser(size_t index, const OSVRUser &user);
+
+    // Column of a Number field of OSVRUser::fields(), one value per profile
+    const vector<double> &numbers(size_t field) const;
+
+    // Make a profile the active one. Fails, keeping the active profile, if
+    // there is no such profile.
+    bool select(Id id);
+    bool select(const string &name);
+    // The active profile's id, or noId
+    Id activeId() const;
+    // The active profile's settings; the defaults when none is active.
+    const OSVRUser &active() const;
+    // Worked out from active() whenever the active profile changes
+    const OSVRUserDerived &activeDerived() const;
+    // Change the active profile's settings. With none active, adds an
+    // unnamed profile and makes it active.
+    void setActive(const OSVRUser &user);
+    // Be told which fields of active() changed, once per select(),
+    // setActive() or read() that changed any of interest. Switching between
+    // profiles with the same settings tells nothing.
+    int subscribe(OSVRUser::FieldMask interest, const OSVRUser::Observer &observer);
+    void unsubscribe(int id);
+
+    // Read either a settings file holding a list of profiles:
+    //   {"profiles": [{"personalSettings": {"name": ...}}, ...],
+    //    "activeProfile": name}
+    // or the single-profile layout, {"personalSettings": {...}}. Without an
+    // "activeProfile" the first profile is active. A profile of the list
+    // named like an earlier one, or unnamed like an earlier one, is kept
+    // under a new name, "name (n)" or "profile n" for the n-th of the list,
+    // and a line saying so is appended to problems.
+    void read(const Json::Value &json, string *problems = nullptr);
+    // Write the list of profiles, or the single-profile layout when there is
+    // only one, so that tools reading one profile keep working.
+    void write(Json::Value &json) const;
+
+private:
+    // The values of one field, for every profile
+    struct Column {
+        vector<string> texts;
+        vector<unsigned char> booleans;
+        vector<double> numbers;
+    };
+
+    // Append a profile, under the id its name had before if any
+    size_t insert(const string &name);
+    void resize(size_t size);
+    void store(size_t index, const OSVRUser &user);
+    void load(size_t index, OSVRUser &user) const;
+    void moveRow(size_t from, size_t to);
+    void activate(size_t index, const OSVRUser &user);
+    // Catch activeDerived() up with what activate() changed, and tell the
+    // observers
+    void publish();
+
+    vector<Column> mColumns;
+    vector<string> mNames;
+    vector<Id> mIds;
+    unordered_map<string, size_t> mByName;
+    unordered_map<Id, size_t> mById;
+    // The id of every name added and not removed since, even if read() has
+    // dropped its profile, so that a name reread or added back keeps its id
+    unordered_map<string, Id> mIdOfName;
+    Id mNextId;
+    size_t mActiveIndex;
+    OSVRUser mActive;
+    OSVRUserDerived mActiveDerived;
+};
+
+#endif // USERPROFILESTORE_H
@@ -24,9 +24,149 @@
 // - none
 
 // Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() {
+typedef std::chrono::steady_clock Clock;
+
+/// The settings file the plugin watches
+static std::string settingsPath() {
+#ifdef _WIN32
+	const char *programData = std::getenv("PROGRAMDATA");
+	return std::string(programData ? programData : "C:/ProgramData") + "/OSVR/osvr_user_settings.json";
+#else
+	const char *xdgPath = std::getenv("XDG_CONFIG_HOME");
+	std::string configPath = xdgPath ? std::string(xdgPath) : "/home/" + std::string(std::getenv("USER")) + "/.config";
+	return configPath + "/osvr_user_settings.json";
+#endif
+}
+
+/// Replace the settings file in one step, the way editors save
+static bool saveSettings(const std::string &path, const std::string &text) {
+	std::string temporary = path + ".latency";
+	{
+		std::ofstream file(temporary.c_str(), std::ios::out | std::ios::binary);
+		file << text;
+		if (!file)
+			return false;
+	}
+#ifdef _WIN32
+	std::remove(path.c_str());
+#endif
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+/// Wait up to timeout for the IPD to become value, or, with no value, to
+/// have any. Returns whether it did.
+static bool waitForIPD(osvr::clientkit::ClientContext &context, osvr::clientkit::Interface &IPD,
+	const double *value, Clock::duration timeout) {
+	Clock::time_point deadline = Clock::now() + timeout;
+	do {
+		context.update();
+		OSVR_AnalogState state;
+		OSVR_TimeValue timestamp;
+		if (osvrGetAnalogState(IPD.get(), &timestamp, &state) == OSVR_RETURN_SUCCESS
+			&& (!value || std::fabs(state - *value) < 1e-9))
+			return true;
+	} while (Clock::now() < deadline);
+	return false;
+}
+
+/// Save the settings file count times, each with another IPD, and report
+/// how long each took to reach this client. The settings file is copied to
+/// a backup next to it first, and put back from there afterwards; if the
+/// run is cut short, the backup is left for the user to restore. On Linux,
+/// run the server and this client with XDG_CONFIG_HOME set to a scratch
+/// directory to leave the real settings alone.
+static int measureLatency(osvr::clientkit::ClientContext &context, osvr::clientkit::Interface &IPD, int count) {
+	if (!waitForIPD(context, IPD, nullptr, std::chrono::seconds(10))){
+		std::cout << "No IPD from the server; is the user settings plugin loaded?" << std::endl;
+		return 1;
+	}
+
+	std::string path = settingsPath();
+	std::string backup = path + ".before-latency";
+	if (std::ifstream(backup.c_str()).is_open()){
+		std::cout << backup << " is left from an earlier run; put it back as " << path
+			<< " or remove it, then try again" << std::endl;
+		return 1;
+	}
+	std::ifstream original(path.c_str(), std::ios::in | std::ios::binary);
+	bool existed = original.is_open();
+	std::string saved((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+	original.close();
+	if (existed){
+		std::ofstream file(backup.c_str(), std::ios::out | std::ios::binary);
+		file << saved;
+		file.close();
+		if (!file){
+			std::cout << "Couldn't back up " << path << " to " << backup << std::endl;
+			std::remove(backup.c_str());
+			return 1;
+		}
+		std::cout << "Timing saves of " << path << "; it is backed up to " << backup
+			<< " until the run ends" << std::endl;
+	}
+#ifndef _WIN32
+	if (!std::getenv("XDG_CONFIG_HOME"))
+		std::cout << "To leave your settings alone, run the server and this client with XDG_CONFIG_HOME set to a scratch directory" << std::endl;
+#endif
+
+	// Apart enough for the plugin to read each save on its own
+	const char *window = std::getenv("OSVR_USER_SETTINGS_RELOAD_MS");
+	std::chrono::milliseconds interval((window ? std::atoi(window) : 100) + 100);
+
+	std::vector<double> latencies;
+	int timeouts = 0;
+	for (int i = 0; i < count; ++i){
+		// An unusual value, different each time
+		double pupilDistance = 25.0 + 0.01 * (i % 1000) + 0.00390625;
+		std::ostringstream text;
+		text.precision(17);
+		text << "{\"personalSettings\": {\"eyes\": {\"left\": {\"pupilDistance\": " << pupilDistance
+			<< "}, \"right\": {\"pupilDistance\": " << pupilDistance << "}}}}\n";
+		Clock::time_point savedAt = Clock::now();
+		if (!saveSettings(path, text.str())){
+			std::cout << "Couldn't write " << path << std::endl;
+			break;
+		}
+		double ipd = 2 * pupilDistance;
+		if (waitForIPD(context, IPD, &ipd, std::chrono::seconds(5)))
+			latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - savedAt).count());
+		else
+			++timeouts;
+		std::this_thread::sleep_for(interval);
+	}
+
+	if (!existed)
+		std::remove(path.c_str());
+	else if (saveSettings(path, saved))
+		std::remove(backup.c_str());
+	else
+		std::cout << "Couldn't put " << path << " back; its contents are in " << backup << std::endl;
+
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << "Save to client latency over " << latencies.size() << " saves, " << timeouts << " timed out";
+	if (!latencies.empty())
+		std::cout << ": p50 " << latencies[size_t(0.5 * (latencies.size() - 1))] << " ms"
+			<< ", p99 " << latencies[size_t(0.99 * (latencies.size() - 1))] << " ms"
+			<< ", max " << latencies.back() << " ms";
+	std::cout << std::endl;
+	return timeouts ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
     osvr::clientkit::ClientContext context(
         "com.osvr.UserSettingsClient");
 
@@ -42,6 +182,10 @@ int main() {
 	osvr::clientkit::Interface SeatedHeight =
 		context.getInterface("/me/SeatedHeight");
 
+	// UserSettingsClient --latency N: time N saves of the settings file
+	if (argc == 3 && std::strcmp(argv[1], "--latency") == 0)
+		return measureLatency(context, IPD, std::atoi(argv[2]));
+
 	// Pretend that this is your application's mainloop.
     for (int i = 0; i < 100000000; ++i) {
         context.update();
@@ -26,28 +26,273 @@
 // - none
 
 // Standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
-// set up for file watching
+// set up for file watching: inotify on Linux, unless the CMake option
+// USERSETTINGS_USE_FSWATCH defines that macro, and libfswatch elsewhere
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#if defined(__linux__) && !defined(USERSETTINGS_USE_FSWATCH)
+#define USERSETTINGS_INOTIFY
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#else
 #include <libfswatch/c++/monitor.hpp>
+#endif
 
 #include "../osvruser.h"
+#include "../userprofilestore.h"
+#include "../profiledatabase.h"
 
 struct Constants{
 	static string config_file;
 	static string config_path;
+	static string profile_database;
+	/// Watcher events this close together cause one reload. Overridden by
+	/// the OSVR_USER_SETTINGS_RELOAD_MS environment variable.
+	static unsigned reload_window_ms;
+	/// Attempts at a file found half-written before waiting for the next
+	/// watcher event
+	static unsigned reload_retries;
 };
 
 string Constants::config_file = "osvr_user_settings.json";
+string Constants::profile_database = "osvr_user_profiles.db";
 string Constants::config_path = "C:/ProgramData/OSVR/";
+unsigned Constants::reload_window_ms = 100;
+unsigned Constants::reload_retries = 3;
 
 // namespace to avoid symbol collision
 namespace usersettingsplugin {
+
+/// Size and modification time of a file, to tell an unchanged file without
+/// reading it
+struct FileStamp {
+	bool exists;
+	uint64_t size;
+	int64_t mtimeNs;
+	/// Whether mtimeNs resolves saves within the same second
+	bool precise;
+
+	bool operator==(const FileStamp &other) const {
+		return exists == other.exists && size == other.size && mtimeNs == other.mtimeNs;
+	}
+	bool operator!=(const FileStamp &other) const { return !(*this == other); }
+};
+
+static FileStamp stampOf(const string &path) {
+	FileStamp stamp = {false, 0, 0, false};
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return stamp;
+	stamp.exists = true;
+	stamp.size = uint64_t(info.st_size);
+#if defined(__linux__)
+	stamp.mtimeNs = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+	stamp.precise = true;
+#elif defined(__APPLE__)
+	stamp.mtimeNs = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+	stamp.precise = true;
+#else
+	stamp.mtimeNs = int64_t(info.st_mtime) * 1000000000;
+#endif
+	return stamp;
+}
+
+/// 64-bit FNV-1a of the bytes of a file
+static uint64_t contentHash(const string &text) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < text.size(); ++i){
+		hash ^= static_cast<unsigned char>(text[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/// Counts of what the file watcher caused
+struct ReloadStats {
+	/// Reloads asked for by the watcher
+	uint64_t events;
+	/// Settings files parsed and applied
+	uint64_t reloads;
+	/// Reloads that found the file unchanged: same size and mtime, same
+	/// bytes, or the same settings with other whitespace
+	uint64_t skipped;
+	/// Files found empty, growing while read, or unparsable
+	uint64_t rejected;
+};
+
+/// Hands values from writer threads to a single reader without locks: a
+/// triple buffer. Writers, one at a time, fill back() and publish() it; the
+/// reader calls acquire() and then reads front(). Neither side ever waits
+/// for the other, and the reader always gets the latest complete value.
+template <typename T>
+class SnapshotBuffer {
+  public:
+	SnapshotBuffer() : m_front(0), m_middle(1), m_back(2) {}
+
+	T &back() { return m_slots[m_back]; }
+	void publish() {
+		m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndex;
+	}
+
+	/// Take the latest published value as front(). False if there has
+	/// been none since the last call.
+	bool acquire() {
+		if (!(m_middle.load(std::memory_order_relaxed) & kFresh))
+			return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndex;
+		return true;
+	}
+	const T &front() const { return m_slots[m_front]; }
+
+  private:
+	static const unsigned kIndex = 3;
+	static const unsigned kFresh = 4;
+
+	T m_slots[3];
+	/// Owned by the reader
+	unsigned m_front;
+	/// The slot passed between the two sides, and whether it is unread
+	std::atomic<unsigned> m_middle;
+	/// Owned by the writer
+	unsigned m_back;
+};
+
+/// Counts of durations, in buckets an eighth of a power of two wide, so
+/// that percentiles come out within 12.5%. Recording is one relaxed
+/// atomic increment, safe from any thread; reading walks the buckets.
+class LatencyHistogram {
+  public:
+	LatencyHistogram() {
+		for (size_t i = 0; i < kBuckets; ++i)
+			m_counts[i] = 0;
+		m_max = 0;
+	}
+
+	void record(uint64_t ns) {
+		m_counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+		uint64_t max = m_max.load(std::memory_order_relaxed);
+		while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+			;
+	}
+
+	uint64_t count() const {
+		uint64_t total = 0;
+		for (size_t i = 0; i < kBuckets; ++i)
+			total += m_counts[i].load(std::memory_order_relaxed);
+		return total;
+	}
+
+	uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+	/// The upper bound of the bucket holding the given fraction of the
+	/// durations recorded, or 0 if there are none
+	uint64_t percentile(double fraction) const {
+		uint64_t total = count();
+		if (!total)
+			return 0;
+		uint64_t rank = uint64_t(fraction * (total - 1)) + 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < kBuckets; ++i){
+			seen += m_counts[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+				return std::min(upperBound(i), max());
+		}
+		return max();
+	}
+
+  private:
+	static const size_t kSubBuckets = 8;
+	static const size_t kBuckets = 62 * kSubBuckets;
+
+	static size_t bucket(uint64_t ns) {
+		if (ns < kSubBuckets)
+			return size_t(ns);
+		unsigned exponent = 63;
+		while (!(ns >> exponent))
+			--exponent;
+		return (exponent - 2) * kSubBuckets + size_t((ns >> (exponent - 3)) & (kSubBuckets - 1));
+	}
+
+	static uint64_t upperBound(size_t index) {
+		if (index < kSubBuckets)
+			return index;
+		unsigned exponent = unsigned(index / kSubBuckets) + 2;
+		uint64_t step = uint64_t(1) << (exponent - 3);
+		return (kSubBuckets + index % kSubBuckets + 1) * step - 1;
+	}
+
+	std::atomic<uint64_t> m_counts[kBuckets];
+	std::atomic<uint64_t> m_max;
+};
+
+/// Stages a change to the settings file goes through on its way to the
+/// clients, each timed from the end of the one before
+enum LatencyStage {
+	/// From the watcher's event to the parsed settings, including the
+	/// coalescing window
+	DetectToParse,
+	/// To the snapshot handed to update()
+	ParseToSwap,
+	/// To osvrDeviceAnalogSetValues() having returned
+	SwapToSet,
+	/// The whole way
+	DetectToSet,
+	LatencyStageCount
+};
+
+static const char *const latencyStageNames[LatencyStageCount] = {
+	"detect->parse", "parse->swap", "swap->set", "detect->set"
+};
+
+/// Channels of the analog interface
+enum {
+	/// The user settings
+	kSettingsChannels = 4,
+	/// Diagnostics: 50th and 99th percentile of detect->set, in
+	/// microseconds, up to the previous change
+	kLatencyP50Channel = kSettingsChannels,
+	kLatencyP99Channel,
+	kChannels
+};
+
+/// What update() reports
+struct UserSettingsSnapshot {
+	OSVR_AnalogState values[kSettingsChannels];
+	/// steady_clock times, in ns, of a settings file change this snapshot
+	/// carries: seen by the watcher, parsed, and published. 0 for a
+	/// snapshot with another cause.
+	int64_t detectedNs;
+	int64_t parsedNs;
+	int64_t swappedNs;
+};
+
+static int64_t steadyNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef USERSETTINGS_INOTIFY
 void filewatcher_cb(const std::vector<fsw::event>& events, void *data);
+#endif
 class AnalogSyncDevice {
   public:
     AnalogSyncDevice(OSVR_PluginRegContext ctx) : m_myVal(0) {
@@ -73,12 +318,35 @@ class AnalogSyncDevice {
                 std::cout << "UserSettings: Using config file " << ss << std::endl;
 #endif
 
-		readConfigFile(ss);
+		// Republish only when a reported value changed
+		OSVRUser::FieldMask reported = OSVRUser::fieldMask("/personalSettings/eyes/left/pupilDistance")
+			| OSVRUser::fieldMask("/personalSettings/eyes/right/pupilDistance")
+			| OSVRUser::fieldMask("/personalSettings/anthropometric/standingEyeHeight")
+			| OSVRUser::fieldMask("/personalSettings/anthropometric/seatedEyeHeight");
+		m_profiles.subscribe(reported, [this](const OSVRUser &, OSVRUser::FieldMask){
+			m_republish = true;
+		});
+
+		if (const char *window = std::getenv("OSVR_USER_SETTINGS_RELOAD_MS"))
+			Constants::reload_window_ms = unsigned(std::atoi(window));
+
+		// The loader reads the settings first, then whatever the watcher
+		// reports
+		m_configFile = string(ss.begin(), ss.end());
+#ifdef USERSETTINGS_INOTIFY
+		long Result = watchConfigFile();
+		m_loader = std::thread(&AnalogSyncDevice::runLoader, this);
+#else
+		m_loader = std::thread(&AnalogSyncDevice::runLoader, this);
+
                 std::vector<std::string> files;
                 files.push_back(ss);
+                files.push_back(Constants::config_path + "/" + Constants::profile_database);
                 active_monitor = fsw::monitor_factory::create_monitor(fsw_monitor_type::system_default_monitor_type, files, &filewatcher_cb);
-                active_monitor->start();
-		long Result = 0; //m_FileWatcher.addPath(path);
+                // start() runs the monitor until stop()
+                m_watcher = std::thread([this]{ active_monitor->start(); });
+		long Result = 0;
+#endif
 		if (Result == 0){
 			std::cout << "UserSettings: file watch on " << string(ss.begin(),ss.end()) << " setup." << std::endl;
 		}
@@ -89,8 +357,8 @@ class AnalogSyncDevice {
 		/// Create the initialization options
         OSVR_DeviceInitOptions opts = osvrDeviceCreateInitOptions(ctx);
 
-        /// Indicate that we'll want 3 analog channels.
-        osvrDeviceAnalogConfigure(opts, &m_analog, 4);
+        /// Indicate that we'll want 4 analog channels, and the diagnostic ones.
+        osvrDeviceAnalogConfigure(opts, &m_analog, kChannels);
 
         /// Create the sync device token with the options
         m_dev.initSync(ctx, "UserSettings", opts);
@@ -103,30 +371,123 @@ class AnalogSyncDevice {
         m_dev.registerUpdateCallback(this);
 	};
 
-	void readConfigFile(string file_locator){
+	~AnalogSyncDevice(){
+#ifndef USERSETTINGS_INOTIFY
+		active_monitor->stop();
+		m_watcher.join();
+		delete active_monitor;
+#endif
+		post(LoaderRequest::Stop);
+		m_loader.join();
+#ifdef USERSETTINGS_INOTIFY
+		close(m_epoll);
+		close(m_inotify);
+		close(m_wakeup);
+#endif
 
-		std::ifstream file_id;
-		file_id.open(file_locator);
+		ReloadStats stats = reloadStats();
+		std::cout << "UserSettings: " << stats.events << " file events, " << stats.reloads << " reloads, "
+			<< stats.skipped << " skipped, " << stats.rejected << " rejected" << std::endl;
+		dumpLatency(std::cout);
+	};
 
-		Json::Reader reader;
-		Json::Value value;
-		if (!reader.parse(file_id, value)){
+	/// Have the loader read the settings file again, once the events in
+	/// the same reload window are in. Called by the file watcher; returns
+	/// at once.
+	void reload(){
+		++m_events;
+		post(LoaderRequest::Reload);
+	};
+
+	ReloadStats reloadStats() const {
+		ReloadStats stats = {m_events.load(), m_reloads.load(), m_skipped.load(), m_rejected.load()};
+		return stats;
+	};
+
+	enum LoadResult {Loaded, Unchanged, Rejected, Created};
+
+	LoadResult readConfigFile(string file_locator){
+		FileStamp stamp = stampOf(file_locator);
+		if (!stamp.exists){
 			std::cout << "USER_SETTINGS_PLUGIN: Couldn't open save file, creating file.\n";
-			// close file first just in case...
-			file_id.close();
 			// new file just has default values
 			writeConfigFile(file_locator);
+			m_configStamp = stampOf(file_locator);
+			return Created;
 		}
-		else{
-			m_osvrUser.read(value);
-			file_id.close();
+		if (m_hasConfigHash && stamp.precise && stamp == m_configStamp){
+			++m_skipped;
+			return Unchanged;
+		}
+
+		std::ifstream file_id(file_locator.c_str(), std::ios::in | std::ios::binary);
+		string text((std::istreambuf_iterator<char>(file_id)), std::istreambuf_iterator<char>());
+		file_id.close();
+		// An editor may have truncated the file and not yet written it, or
+		// be writing it still
+		if (text.empty() || stampOf(file_locator) != stamp){
+			std::cout << "UserSettings: settings file is being written, reload postponed" << std::endl;
+			++m_rejected;
+			return Rejected;
+		}
+		uint64_t bytesHash = contentHash(text);
+		if (m_hasConfigHash && bytesHash == m_configBytesHash){
+			m_configStamp = stamp;
+			++m_skipped;
+			return Unchanged;
 		}
+
+		// The tree only lives until m_profiles has copied the fields out, so
+		// parse it into an arena and drop it in one go.
+		Json::CharReaderBuilder builder;
+		builder.useArena_ = true;
+		std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+		Json::Document document;
+		std::string errs;
+		if (!reader->parse(text.data(), text.data() + text.size(), &document, &errs)){
+			// Keep the settings already read rather than overwrite a file
+			// someone is editing
+			std::cout << "UserSettings: settings file unreadable, keeping the current settings\n" << errs;
+			++m_rejected;
+			return Rejected;
+		}
+		m_configStamp = stamp;
+		m_configBytesHash = bytesHash;
+
+		// Saving without changes, or changing only whitespace, still
+		// fires the watcher: keep the settings already read.
+		Json::Value::LargestUInt hash = document.root().hash();
+		if (m_hasConfigHash && hash == m_configHash){
+			++m_skipped;
+			return Unchanged;
+		}
+		// An "activeProfile" missing from the file may be in the database:
+		// read it along with the file's, so that the store switches once
+		const Json::Value *settings = &document.root();
+		Json::Value merged, profile;
+		m_activeFromDatabase = m_profileDatabase.activeProfile(document.root(), profile);
+		if (m_activeFromDatabase){
+			merged = document.root();
+			merged["profiles"].append(profile);
+			settings = &merged;
+			std::cout << "UserSettings: profile " << merged["activeProfile"].asString() << " read from the database" << std::endl;
+		}
+		string problems;
+		m_profiles.read(*settings, &problems);
+		if (!problems.empty())
+			std::cout << "UserSettings: " << problems;
+		m_configHash = hash;
+		m_hasConfigHash = true;
+		++m_reloads;
+		return Loaded;
 	};
 
 	void writeConfigFile(string file_locator){
 		// retreive Json string. should be just the default values.
 		Json::Value value;
-		m_osvrUser.write(value);
+		if (m_profiles.size() == 0)
+			m_profiles.setActive(OSVRUser());
+		m_profiles.write(value);
 
 		// open the file
 		std::ofstream file_id;
@@ -138,39 +499,339 @@ class AnalogSyncDevice {
 		file_id.close();
 	};
 
+	/// Runs on the server thread: never reads the file or m_profiles, only
+	/// the latest snapshot.
 	OSVR_ReturnCode update() {
-
-		if (m_fileChange){
-			std::cout << "UserSettings: file changed..." << std::endl;
-			m_fileChange = 0;
-			readConfigFile(Constants::config_path + Constants::config_file);
+		if (!m_snapshots.acquire())
+			return OSVR_RETURN_SUCCESS;
+
+		const UserSettingsSnapshot &snapshot = m_snapshots.front();
+		OSVR_AnalogState values[kChannels];
+		std::copy(snapshot.values, snapshot.values + kSettingsChannels, values);
+		values[kLatencyP50Channel] = m_latency[DetectToSet].percentile(0.5) / 1000.0;
+		values[kLatencyP99Channel] = m_latency[DetectToSet].percentile(0.99) / 1000.0;
+		osvrDeviceAnalogSetValues(m_dev, m_analog, values, kChannels);
+
+		if (snapshot.detectedNs){
+			int64_t setNs = steadyNs();
+			m_latency[DetectToParse].record(uint64_t(snapshot.parsedNs - snapshot.detectedNs));
+			m_latency[ParseToSwap].record(uint64_t(snapshot.swappedNs - snapshot.parsedNs));
+			m_latency[SwapToSet].record(uint64_t(setNs - snapshot.swappedNs));
+			m_latency[DetectToSet].record(uint64_t(setNs - snapshot.detectedNs));
 		}
 
-		OSVR_AnalogState values[4];
-
-		values[0] = m_osvrUser.pupilDistance(OS) + m_osvrUser.pupilDistance(OD);
-		values[1] = m_osvrUser.standingEyeHeight();
-		values[2] = m_osvrUser.seatedEyeHeight();
-		values[3] = rand();
-		osvrDeviceAnalogSetValues(m_dev, m_analog, values, 4);
-
 		return OSVR_RETURN_SUCCESS;
 		};
 
-	long m_fileChange = 0;
+	/// Write the count, median, 99th percentile and maximum of each stage
+	/// of the settings file changes published so far.
+	void dumpLatency(std::ostream &out) const {
+		for (int stage = 0; stage < LatencyStageCount; ++stage){
+			const LatencyHistogram &histogram = m_latency[stage];
+			out << "UserSettings: latency " << latencyStageNames[stage]
+				<< ": n=" << histogram.count()
+				<< " p50=" << histogram.percentile(0.5) / 1000.0 << "us"
+				<< " p99=" << histogram.percentile(0.99) / 1000.0 << "us"
+				<< " max=" << histogram.max() / 1000.0 << "us" << std::endl;
+		}
+	};
 
   private:
-	OSVRUser m_osvrUser;
+	struct LoaderRequest {
+		enum Type {Reload, Stop};
+		Type type;
+		/// steadyNs() when posted
+		int64_t postedNs;
+	};
+
+	void post(LoaderRequest::Type type){
+		LoaderRequest request = {type, steadyNs()};
+		{
+			std::lock_guard<std::mutex> lock(m_requestLock);
+			m_requests.push_back(request);
+		}
+#ifdef USERSETTINGS_INOTIFY
+		uint64_t one = 1;
+		if (write(m_wakeup, &one, sizeof one) < 0)
+			std::cout << "UserSettings: couldn't wake the loader" << std::endl;
+#else
+		m_requestReady.notify_one();
+#endif
+	};
+
+#ifdef USERSETTINGS_INOTIFY
+	/// Set up the loader's epoll set: its wakeup eventfd and an inotify
+	/// watch on the directory of the settings file and profile database.
+	/// Watching the directory rather than the files sees saves that write a
+	/// temporary file and rename it over the settings, and the database
+	/// replaced the same way. Returns 0 or the errno of the failure.
+	long watchConfigFile(){
+		m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		m_epoll = epoll_create1(EPOLL_CLOEXEC);
+
+		size_t slash = m_configFile.rfind('/');
+		string directory = slash == string::npos ? string(".") : m_configFile.substr(0, slash + 1);
+		m_configName = m_configFile.substr(slash == string::npos ? 0 : slash + 1);
+
+		epoll_event wakeup = {};
+		wakeup.events = EPOLLIN;
+		wakeup.data.fd = m_wakeup;
+		epoll_event watch = {};
+		watch.events = EPOLLIN;
+		watch.data.fd = m_inotify;
+		if (m_wakeup < 0 || m_inotify < 0 || m_epoll < 0
+			|| epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &wakeup) != 0
+			|| epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_inotify, &watch) != 0
+			|| inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+			return errno;
+		return 0;
+	};
+
+	/// Wait for requests, a change to the settings file or database, or the
+	/// timeout. Returns whether either file changed.
+	bool waitForWork(int timeoutMs){
+		epoll_event events[2];
+		int count = epoll_wait(m_epoll, events, 2, timeoutMs);
+		bool changed = false;
+		for (int i = 0; i < count; ++i){
+			if (events[i].data.fd == m_wakeup){
+				uint64_t posted;
+				if (read(m_wakeup, &posted, sizeof posted) < 0)
+					continue;
+			}
+			else if (events[i].data.fd == m_inotify)
+				changed |= readWatchEvents();
+		}
+		return changed;
+	};
+
+	/// Drain the inotify queue. Returns whether any event was about the
+	/// settings file or the profile database.
+	bool readWatchEvents(){
+		bool changed = false;
+		alignas(inotify_event) char buffer[4096];
+		for (;;){
+			ssize_t length = read(m_inotify, buffer, sizeof buffer);
+			if (length <= 0)
+				return changed;
+			for (ssize_t offset = 0; offset < length; ){
+				const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+				if (event->len && (m_configName == event->name || Constants::profile_database == event->name)){
+					++m_events;
+					changed = true;
+				}
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+	};
+#endif
+
+	/// The loader's event loop: all file access and parsing happens here,
+	/// so that update() never waits for the disk.
+	void runLoader(){
+		// Profiles missing from the settings file are looked up in the
+		// database next to it, if there is one
+		m_databaseFile = m_configFile;
+		m_databaseFile.replace(m_databaseFile.size() - Constants::config_file.size(), string::npos, Constants::profile_database);
+		reopenDatabase();
+		readConfigFile(m_configFile);
+		publish();
+
+		// A reload is due at the end of the window opened by the first
+		// event; the events arriving meanwhile fold into it
+		typedef std::chrono::steady_clock Clock;
+		std::chrono::milliseconds window(Constants::reload_window_ms);
+		bool reloadPending = false;
+		Clock::time_point reloadDue;
+		unsigned retries = 0;
+
+		std::deque<LoaderRequest> requests;
+		for (;;){
+#ifdef USERSETTINGS_INOTIFY
+			int timeoutMs = -1;
+			if (reloadPending){
+				// Rounded up, so as not to wake before the window closes
+				Clock::duration left = reloadDue - Clock::now();
+				timeoutMs = left.count() <= 0 ? 0
+					: int(std::chrono::duration_cast<std::chrono::milliseconds>(left).count()) + 1;
+			}
+			if (waitForWork(timeoutMs)){
+				LoaderRequest changed = {LoaderRequest::Reload, steadyNs()};
+				requests.push_back(changed);
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_requestLock);
+				requests.insert(requests.end(), m_requests.begin(), m_requests.end());
+				m_requests.clear();
+			}
+#else
+			{
+				std::unique_lock<std::mutex> lock(m_requestLock);
+				if (reloadPending)
+					m_requestReady.wait_until(lock, reloadDue, [this]{ return !m_requests.empty(); });
+				else
+					m_requestReady.wait(lock, [this]{ return !m_requests.empty(); });
+				requests.swap(m_requests);
+			}
+#endif
+			for (size_t i = 0; i < requests.size(); ++i){
+				switch (requests[i].type){
+					case LoaderRequest::Reload:
+						if (!reloadPending){
+							reloadPending = true;
+							reloadDue = Clock::now() + window;
+							m_detectedNs = requests[i].postedNs;
+						}
+						retries = 0;
+						break;
+					case LoaderRequest::Stop:
+						return;
+				}
+			}
+			requests.clear();
+
+			if (reloadPending && Clock::now() >= reloadDue){
+				reloadPending = false;
+				std::cout << "UserSettings: file changed..." << std::endl;
+				// The active profile may come from the new database even
+				// though the settings file is the same
+				if (reopenDatabase())
+					m_hasConfigHash = false;
+				// Look again at a half-written file, in case its writer
+				// sends no further event
+				LoadResult result = readConfigFile(m_configFile);
+				if (result == Loaded)
+					m_parsedNs = steadyNs();
+				if (result == Rejected && retries < Constants::reload_retries){
+					++retries;
+					reloadPending = true;
+					reloadDue = Clock::now() + window;
+				}
+			}
+			publish();
+		}
+	};
+
+	/// Map the profile database again if it was replaced, created or
+	/// removed since it was last opened. Returns whether it was.
+	bool reopenDatabase(){
+		FileStamp stamp = stampOf(m_databaseFile);
+		if (stamp.precise && stamp == m_databaseStamp)
+			return false;
+		if (!stamp.exists && !m_databaseStamp.exists)
+			return false;
+		m_databaseStamp = stamp;
+		string error;
+		if (m_profileDatabase.open(m_databaseFile, &error))
+			std::cout << "UserSettings: " << m_profileDatabase.size() << " profiles in " << m_databaseFile << std::endl;
+		else if (stamp.exists)
+			std::cout << "UserSettings: " << error << std::endl;
+		return true;
+	};
+
+	/// What ActiveProfile (analog/3) reports: the position of the active
+	/// profile in the settings file's "profiles" list, 0 for a file holding
+	/// one profile without a list, or -1 for a profile read from the
+	/// database. The plugin never selects a profile itself; the file's
+	/// "activeProfile" does.
+	double activeProfileIndex() const {
+		// read() keeps the order of the list, and the database's profile
+		// goes after it
+		size_t index = m_profiles.indexOf(m_profiles.activeId());
+		if (m_activeFromDatabase || index == UserProfileStore::npos)
+			return -1;
+		return double(index);
+	};
+
+	/// Snapshot the values update() reports, if any of them changed.
+	void publish(){
+		// A file change is timed only if it reaches update()
+		int64_t parsedNs = m_parsedNs;
+		m_parsedNs = 0;
+		double activeProfile = activeProfileIndex();
+		if (!m_republish && activeProfile == m_publishedProfile)
+			return;
+		m_republish = false;
+		m_publishedProfile = activeProfile;
+
+		UserSettingsSnapshot &snapshot = m_snapshots.back();
+		const OSVRUserDerived &derived = m_profiles.activeDerived();
+		snapshot.values[0] = derived.ipd;
+		snapshot.values[1] = derived.eyeHeight[Standing];
+		snapshot.values[2] = derived.eyeHeight[Seated];
+		snapshot.values[3] = activeProfile;
+		snapshot.detectedNs = parsedNs ? m_detectedNs : 0;
+		snapshot.parsedNs = parsedNs;
+		snapshot.swappedNs = steadyNs();
+		m_snapshots.publish();
+	};
+
 	osvr::pluginkit::DeviceToken m_dev;
     OSVR_AnalogDeviceInterface m_analog;
+#ifndef USERSETTINGS_INOTIFY
     fsw::monitor *active_monitor;
+	/// Runs active_monitor
+	std::thread m_watcher;
+#endif
 	double m_myVal;
 	bool m_initialized = false;
 
+	/// Requests to the loader, from any thread
+	std::mutex m_requestLock;
+#ifdef USERSETTINGS_INOTIFY
+	/// Wakes the loader's epoll_wait
+	int m_wakeup = -1;
+	int m_inotify = -1;
+	int m_epoll = -1;
+	/// The settings file's name in its directory
+	string m_configName;
+#else
+	std::condition_variable m_requestReady;
+#endif
+	std::deque<LoaderRequest> m_requests;
+	std::thread m_loader;
+
+	/// Read by reloadStats() from any thread
+	std::atomic<uint64_t> m_events{0};
+	std::atomic<uint64_t> m_reloads{0};
+	std::atomic<uint64_t> m_skipped{0};
+	std::atomic<uint64_t> m_rejected{0};
+
+	/// The members from here to m_snapshots belong to the loader thread
+	string m_configFile;
+	/// Every profile of the settings file; the active one is reported
+	UserProfileStore m_profiles;
+	/// Mapped osvr_user_profiles.db, if present
+	string m_databaseFile;
+	ProfileDatabase m_profileDatabase;
+	/// What the database file was when last opened
+	FileStamp m_databaseStamp = {false, 0, 0, false};
+	/// What the settings file held when last read
+	FileStamp m_configStamp = {false, 0, 0, false};
+	uint64_t m_configBytesHash = 0;
+	Json::Value::LargestUInt m_configHash = 0;
+	bool m_hasConfigHash = false;
+	/// Set by m_profiles when a reported value changes; the first
+	/// publish() always publishes
+	bool m_republish = true;
+	double m_publishedProfile = -1;
+	/// Whether the active profile was read from m_profileDatabase
+	bool m_activeFromDatabase = false;
+	/// When the change being read was seen, and when it was parsed
+	int64_t m_detectedNs = 0;
+	int64_t m_parsedNs = 0;
+	/// From the writers to update()
+	SnapshotBuffer<UserSettingsSnapshot> m_snapshots;
+
+	/// Recorded by update(), read from any thread
+	LatencyHistogram m_latency[LatencyStageCount];
+
 };
 
 //TODO: Get this into the AnalogSyncDevice class
 AnalogSyncDevice *asd = NULL;
+#ifndef USERSETTINGS_INOTIFY
 void filewatcher_cb(const std::vector<fsw::event>& events,
                                       void *data) {
     //std::cout << "Callback" << std::endl;
@@ -179,13 +840,14 @@ void filewatcher_cb(const std::vector<fsw::event>& events,
         if (e.get_path() != "" /*whyever this happens*/ && e.get_event_flag_by_name("Updated")) { //TODO: Does it work this way?
             std::cout << e.get_path() << " changed..." << std::endl;
             if (asd != NULL) {
-                asd->update();
+                asd->reload();
             }
         } else {
             //std::cout << "foo" << std::endl;
         }
     }
 }
+#endif
 
 class HardwareDetection {
   public: